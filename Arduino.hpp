@@ -22,113 +22,1021 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-// Want to define these so that I don't get a bunch of lint issues
-// in the editor.  Taking advantage of the fact that arduino defines
-// max as a macro.
+/*
+On a real board the Arduino core defines max as a macro, so everything below is
+skipped.  Anywhere else this is a host simulation of the parts of the Arduino API
+that these libraries use, so sketches can be built and run on Linux:
+
+- A virtual clock.  Time only moves when something advances it (Sim.advance(),
+  delay(), or the HOST_MAIN runner between passes), so runs are deterministic.
+- A GPIO model of 8 ports x 8 pins.  Input pins can be set directly, scripted with
+  timed steps, or driven by a Waveform.  Outputs remember what was written.
+- Switches between pins (Sim.link()), enough to wire up a key matrix, ghosting and
+  all.
+- Port registers (digitalPinToPort(), portInputRegister() and so on) that map onto
+  the same model, 8 pins to a port.
+- Interrupts: every pin can have one (digitalPinToInterrupt(pin) is just pin), and
+  the handler runs at the exact simulated time the pin changes.
+- An ADC model: each pin has an analog value, optionally driven by a function of time.
+- Capture of Serial output (and scripted Serial input), Keyboard and Mouse events,
+  and SSD1306 frames.  Wire delivers transmissions to attached HostI2CDevices, and
+  the SSD1306 is one, so partial updates end up on the modelled panel too.  Each
+  transmission takes as long as it would on the bus.
+- hostNanos() (wall clock) and hostAllocations (count of operator new calls) for
+  benchmarking the library itself; see examples/Benchmark.
+
+Build a sketch with HOST_MAIN defined to get a main() that calls setup() and then
+loop() for a number of passes, advancing the clock between them:
+
+g++ -std=gnu++17 -O2 -DHOST_MAIN -I. -Ihost -x c++ examples/Encoder/Encoder.ino -o encoder
+./encoder [passes] [microsPerPass]
+
+The host directory has stand-ins for Mouse.h, Wire.h, Adafruit_SSD1306.h and friends.
+*/
 #ifndef max
+
+#define ARDUINO_HOST
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include <chrono>
+
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define constrain(x, a, b) (max((a), min((x), (b))))
-#define random(a, b) (0)
-void delay(long ms) { }
-long millis() { return 0; }
-void tone(uint8_t,uint16_t) { }
-void noTone(uint8_t) { }
-#define INPUT_PULLUP 1
-#define INPUT 1
+
+#define INPUT 0
 #define OUTPUT 1
+#define INPUT_PULLUP 2
 #define HIGH 1
 #define LOW 0
-#define NULL 0
-#define LED_BUILTIN 1
-void pinMode(int i, int j) { }
-bool digitalRead(int i) { return LOW; }
-void digitalWrite(int i, bool j) { }
-int analogRead(int i) { return 0; }
-void analogWrite(int i, int j) { }
-void strcpy(char*, const char*) { }
-#define DEC 1
-class Outputter {
-public:
-	bool available() { }
-	String readString() { }
-	void print(const char*) { }
-	void print(long) { }
-	void print(long,short) {}
-	void print(short,short) {}
-	void print(bool,short) {}
-	void print(short) { }
-	void println(const char*) { }
-	void println(int,int) {}
-	void println() { }
-	void println(long) { }
-	void println(short) { }
-};
-Outputter Serial;
-class PressyThing {
-public:
-	void press(int) { }
-	void release(int) { }
-	void releaseAll() { }
-	void move(int,int,int) { }
-};
-#define KEY_F5 123
-PressyThing Keyboard;
-PressyThing Mouse;
-typedef int int16_t;
-typedef unsigned int uint16_t;
-typedef char int8_t;
-typedef unsigned char uint8_t;
-typedef char GFXfont;
-class Adafruit_GFX {
-public:
-	void drawBitmap(int16_t,int16_t,const uint8_t *,int16_t,int16_t,uint16_t) { }
-	void setFont(const GFXfont *) { }
-	void setTextSize(uint8_t) { }
-	void setTextColor(uint16_t,uint16_t) { }
-	void setCursor(int16_t,int16_t) { }
-	void print(const String&) { }
-	void drawCircle(int16_t,int16_t,int16_t,uint16_t) { }
-	void fillCircle(int16_t,int16_t,int16_t,uint16_t) { }
-};
-class Adafruit_SSD1306 : public Adafruit_GFX {
-public:
-	void clearDisplay() { }
-	void display() { }
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+#define LED_BUILTIN 13
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define F(text) (text)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/**
+ * Waveform drives an input pin as a function of time.  nextChange() lets the
+ * simulator step from edge to edge instead of sampling.
+ */
+class Waveform {
+public:
+	virtual bool level(uint64_t micros) const = 0;
+	// The first time after `micros` that level() changes.
+	virtual uint64_t nextChange(uint64_t micros) const = 0;
+};
+
+class SquareWave : public Waveform {
+	const uint64_t _period;
+	const uint64_t _high;
+	const uint64_t _phase;
+public:
+	SquareWave(uint64_t periodMicros, uint64_t highMicros, uint64_t phaseMicros = 0) :
+		_period(periodMicros), _high(highMicros), _phase(phaseMicros) { }
+	bool level(uint64_t micros) const { return ((micros + _period - _phase % _period) % _period) < _high; }
+	uint64_t nextChange(uint64_t micros) const {
+		uint64_t offset = (micros + _period - _phase % _period) % _period;
+		return micros + (offset < _high ? _high - offset : _period - offset);
+	}
+};
+
+/**
+ * SimPin is one simulated pin.  Inputs can be set now, scheduled with at(), or
+ * driven by a Waveform; scheduled steps are applied in time order as the clock moves.
+ */
+class SimPin {
+	friend class Simulator;
+	struct Step {
+		uint64_t time;
+		bool level;
+	};
+	uint8_t _mode;
+	bool _driven;
+	bool _external;
+	const Waveform *_waveform;
+	std::vector<Step> _script;
+	size_t _next;
+	int _analog;
+	int (*_analogSource)(uint64_t micros);
+	int _pwm;
+	unsigned int _tone;
+	unsigned long _writes;
+public:
+	SimPin() : _mode(INPUT), _driven(false), _external(LOW), _waveform(NULL), _next(0),
+		_analog(0), _analogSource(NULL), _pwm(0), _tone(0), _writes(0) { }
+	uint8_t mode() const { return _mode; }
+	int pwm() const { return _pwm; }
+	unsigned int tone() const { return _tone; }
+	unsigned long writes() const { return _writes; }
+	SimPin &at(uint64_t micros, bool level) {
+		Step step = { micros, level };
+		size_t i = _script.size();
+		while (i > _next && _script[i - 1].time > micros) i--;
+		_script.insert(_script.begin() + i, step);
+		return *this;
+	}
+	SimPin &drive(const Waveform &waveform) { _waveform = &waveform; _driven = true; return *this; }
+	SimPin &release() { _waveform = NULL; _driven = false; return *this; }
+	SimPin &analog(int value) { _analog = value; _analogSource = NULL; return *this; }
+	SimPin &analog(int (*source)(uint64_t micros)) { _analogSource = source; return *this; }
+	int analogValue(uint64_t micros) const { return _analogSource ? _analogSource(micros) : _analog; }
+};
+
+struct HIDEvent {
+	uint64_t time;
+	char device; // 'K' or 'M'
+	char action; // 'p'ress, 'r'elease, 'R'eleaseAll, 'm'ove, 'c'lick
+	int code;
+	int x;
+	int y;
 };
-class Adafruit_GFX_Button {
 
+class Simulator {
 public:
-  Adafruit_GFX_Button(void);
-  // "Classic" initButton() uses center & size
-  void initButton(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t w,
-                  uint16_t h, uint16_t outline, uint16_t fill,
-                  uint16_t textcolor, char *label, uint8_t textsize);
-  void initButton(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t w,
-                  uint16_t h, uint16_t outline, uint16_t fill,
-                  uint16_t textcolor, char *label, uint8_t textsize_x,
-                  uint8_t textsize_y);
-  // New/alt initButton() uses upper-left corner & size
-  void initButtonUL(Adafruit_GFX *gfx, int16_t x1, int16_t y1, uint16_t w,
-                    uint16_t h, uint16_t outline, uint16_t fill,
-                    uint16_t textcolor, char *label, uint8_t textsize);
-  void initButtonUL(Adafruit_GFX *gfx, int16_t x1, int16_t y1, uint16_t w,
-                    uint16_t h, uint16_t outline, uint16_t fill,
-                    uint16_t textcolor, char *label, uint8_t textsize_x,
-                    uint8_t textsize_y);
-  void drawButton(bool inverted = false);
-  bool contains(int16_t x, int16_t y);
-  bool isPressed() { }
+	static const int NumPorts = 8;
+	static const int NumPins = NumPorts * 8;
+private:
+	uint64_t _micros;
+	SimPin _pins[NumPins];
+	uint8_t _pinRegister[NumPorts];
+	uint8_t _portRegister[NumPorts];
+	unsigned long _seed;
+	std::vector<HIDEvent> _hid;
+	bool _echoHID;
+	void (*_isr[NumPins])();
+	uint8_t _isrMode[NumPins];
+	bool _pending[NumPins];
+	bool _interruptsEnabled;
+	bool _inInterrupt;
+	unsigned long _portWrites;
+	std::vector<std::pair<uint8_t, uint8_t> > _links;
+	bool _linked[NumPins];
+	void setLevel(int pin, bool level) {
+		uint8_t bit = 1 << (pin & 7);
+		bool was = _pinRegister[pin >> 3] & bit;
+		if (level) {
+			_pinRegister[pin >> 3] |= bit;
+		} else {
+			_pinRegister[pin >> 3] &= ~bit;
+		}
+		if (was != level && _isr[pin] &&
+			(_isrMode[pin] == CHANGE || _isrMode[pin] == (level ? RISING : FALLING))) {
+			_pending[pin] = true;
+			runInterrupts();
+		}
+	}
+	// Like the hardware, a handler doesn't interrupt another one or run while
+	// interrupts are off; it stays pending until it can.
+	void runInterrupts() {
+		if (_inInterrupt || !_interruptsEnabled) return;
+		_inInterrupt = true;
+		for (int pin = 0; pin < NumPins; pin++) {
+			if (_pending[pin]) {
+				_pending[pin] = false;
+				if (_isr[pin]) _isr[pin]();
+				pin = -1;
+			}
+		}
+		_inInterrupt = false;
+	}
+	bool inputLevel(int pin) const {
+		const SimPin &p = _pins[pin];
+		if (p._waveform) {
+			return p._waveform->level(_micros);
+		} else if (p._driven) {
+			return p._external;
+		}
+		return p._mode == INPUT_PULLUP;
+	}
+	void updateInput(int pin) {
+		if (_linked[pin]) {
+			settle(pin);
+		} else if (_pins[pin]._mode != OUTPUT) {
+			setLevel(pin, inputLevel(pin));
+		}
+	}
+	// Pins joined by closed switches (see link()) act as one net: if any of them is an
+	// output, the inputs read LOW if any output is LOW, else HIGH.  With no output
+	// on the net each input reads as it would on its own.
+	void settle(int pin) {
+		bool onNet[NumPins] = { false };
+		int net[NumPins];
+		int size = 0;
+		net[size++] = pin;
+		onNet[pin] = true;
+		for (int i = 0; i < size; i++) {
+			for (size_t j = 0; j < _links.size(); j++) {
+				int other = _links[j].first == net[i] ? _links[j].second :
+					_links[j].second == net[i] ? _links[j].first : -1;
+				if (other >= 0 && !onNet[other]) {
+					onNet[other] = true;
+					net[size++] = other;
+				}
+			}
+		}
+		bool driven = false;
+		bool level = HIGH;
+		for (int i = 0; i < size; i++) {
+			if (_pins[net[i]]._mode == OUTPUT) {
+				driven = true;
+				level = level && ((_portRegister[net[i] >> 3] >> (net[i] & 7)) & 1);
+			}
+		}
+		for (int i = 0; i < size; i++) {
+			if (_pins[net[i]]._mode != OUTPUT) {
+				setLevel(net[i], driven ? level : inputLevel(net[i]));
+			}
+		}
+	}
+	// When the next scripted step or waveform edge after now happens, if before `limit`.
+	bool nextEvent(uint64_t limit, uint64_t &when) const {
+		bool found = false;
+		for (int pin = 0; pin < NumPins; pin++) {
+			const SimPin &p = _pins[pin];
+			if (p._next < p._script.size() && p._script[p._next].time <= limit &&
+				(!found || p._script[p._next].time < when)) {
+				when = p._script[p._next].time;
+				found = true;
+			}
+			if (p._waveform) {
+				uint64_t edge = p._waveform->nextChange(_micros);
+				if (edge <= limit && (!found || edge < when)) {
+					when = edge;
+					found = true;
+				}
+			}
+		}
+		return found;
+	}
+	void applyEvents() {
+		for (int pin = 0; pin < NumPins; pin++) {
+			SimPin &p = _pins[pin];
+			while (p._next < p._script.size() && p._script[p._next].time <= _micros) {
+				p._driven = true;
+				p._external = p._script[p._next].level;
+				p._next++;
+			}
+			if (p._driven || p._waveform) {
+				updateInput(pin);
+			}
+		}
+	}
+public:
+	Simulator() : _micros(0), _seed(1), _echoHID(true), _interruptsEnabled(true), _inInterrupt(false),
+		_portWrites(0) {
+		memset(_pinRegister, 0, sizeof(_pinRegister));
+		memset(_portRegister, 0, sizeof(_portRegister));
+		memset(_isr, 0, sizeof(_isr));
+		memset(_isrMode, 0, sizeof(_isrMode));
+		memset(_pending, 0, sizeof(_pending));
+		memset(_linked, 0, sizeof(_linked));
+	}
+	uint64_t now() const { return _micros; }
+	void advance(uint64_t micros) {
+		uint64_t target = _micros + micros;
+		uint64_t when = target;
+		while (nextEvent(target, when)) {
+			// An event scripted for a time that's already gone happens now.
+			_micros = max(_micros, when);
+			applyEvents();
+		}
+		_micros = target;
+	}
+	void advanceMillis(uint64_t millis) { advance(millis * 1000); }
+	SimPin &pin(int pin) { return _pins[pin]; }
+	// Set an input pin's level right now, as if something external drove it.
+	void set(int pin, bool level) {
+		_pins[pin]._driven = true;
+		_pins[pin]._external = level;
+		updateInput(pin);
+	}
+	// Close (or open) a switch between two pins, like a key in a matrix.
+	void link(int a, int b, bool closed = true) {
+		for (size_t i = 0; i < _links.size(); i++) {
+			if ((_links[i].first == a && _links[i].second == b) || (_links[i].first == b && _links[i].second == a)) {
+				_links.erase(_links.begin() + i);
+				break;
+			}
+		}
+		if (closed) {
+			_links.push_back(std::make_pair((uint8_t)a, (uint8_t)b));
+			_linked[a] = true;
+			_linked[b] = true;
+		}
+		settle(a);
+		settle(b);
+	}
+	bool level(int pin) const { return (_pinRegister[pin >> 3] >> (pin & 7)) & 1; }
+	volatile uint8_t *pinRegister(int port) { return _pinRegister + port; }
+	volatile uint8_t *portRegister(int port) { return _portRegister + port; }
+
+	// Called by the Arduino API stand-ins below.
+	void pinMode(int pin, int mode) {
+		_pins[pin]._mode = mode;
+		if (mode == OUTPUT) {
+			setLevel(pin, (_portRegister[pin >> 3] >> (pin & 7)) & 1);
+		}
+		updateInput(pin);
+	}
+	void digitalWrite(int pin, bool value) {
+		uint8_t bit = 1 << (pin & 7);
+		if (value) {
+			_portRegister[pin >> 3] |= bit;
+		} else {
+			_portRegister[pin >> 3] &= ~bit;
+		}
+		_pins[pin]._writes++;
+		if (_pins[pin]._mode == OUTPUT) {
+			setLevel(pin, value);
+			updateInput(pin);
+		}
+	}
+	// A whole-port write, as with *portOutputRegister() on a board.  Ports count from
+	// 0 here, like pinRegister() and portRegister().
+	void writePort(int port, uint8_t set, uint8_t clear) {
+		_portRegister[port] = (_portRegister[port] & ~clear) | set;
+		_portWrites++;
+		for (int bit = 0; bit < 8; bit++) {
+			int pin = port * 8 + bit;
+			if (((set | clear) >> bit) & 1) {
+				_pins[pin]._writes++;
+			}
+			if (_pins[pin]._mode == OUTPUT) {
+				setLevel(pin, (_portRegister[port] >> bit) & 1);
+				updateInput(pin);
+			}
+		}
+	}
+	unsigned long portWrites() const { return _portWrites; }
+	void analogWrite(int pin, int value) {
+		_pins[pin]._pwm = value;
+		_pins[pin]._writes++;
+		digitalWrite(pin, value >= 128);
+	}
+	void tone(int pin, unsigned int frequency) { _pins[pin]._tone = frequency; }
+	void attachInterrupt(int pin, void (*isr)(), int mode) {
+		_isr[pin] = isr;
+		_isrMode[pin] = mode;
+		_pending[pin] = false;
+	}
+	void detachInterrupt(int pin) { _isr[pin] = NULL; _pending[pin] = false; }
+	void interrupts(bool enabled) {
+		_interruptsEnabled = enabled;
+		runInterrupts();
+	}
+	bool interruptsEnabled() const { return _interruptsEnabled; }
+
+	void randomSeed(unsigned long seed) { _seed = seed ? seed : 1; }
+	long random(long howBig) {
+		if (howBig <= 0) return 0;
+		_seed = _seed * 1103515245UL + 12345UL;
+		return (long)((_seed >> 16) & 0x7FFF) % howBig;
+	}
+
+	void echoHID(bool echo) { _echoHID = echo; }
+	const std::vector<HIDEvent> &hidEvents() const { return _hid; }
+	void hid(char device, char action, int code, int x = 0, int y = 0) {
+		HIDEvent event = { _micros, device, action, code, x, y };
+		_hid.push_back(event);
+		if (_echoHID) {
+			printf("[%lu ms] %s %c %d\n", (unsigned long)(_micros / 1000),
+				device == 'K' ? "Keyboard" : "Mouse", action, code);
+		}
+	}
 };
+
+Simulator Sim;
+
+// Every heap allocation goes through here so benchmarks can count them.
+unsigned long hostAllocations = 0;
+
+void *operator new(size_t size) {
+	hostAllocations++;
+	void *p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+// Out of line, or GCC -Wall sees free() on a pointer from new and calls it a mismatch.
+__attribute__((noinline)) void hostFree(void *p) noexcept { free(p); }
+void operator delete(void *p) noexcept { hostFree(p); }
+void operator delete[](void *p) noexcept { hostFree(p); }
+void operator delete(void *p, size_t) noexcept { hostFree(p); }
+void operator delete[](void *p, size_t) noexcept { hostFree(p); }
+
+// Real (wall clock) time, for benchmarking the host build itself.
+uint64_t hostNanos() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long micros() { return (unsigned long)Sim.now(); }
+unsigned long millis() { return (unsigned long)(Sim.now() / 1000); }
+void delay(unsigned long ms) { Sim.advanceMillis(ms); }
+void delayMicroseconds(unsigned int us) { Sim.advance(us); }
+void pinMode(uint8_t pin, uint8_t mode) { Sim.pinMode(pin, mode); }
+int digitalRead(uint8_t pin) { return Sim.level(pin); }
+void digitalWrite(uint8_t pin, uint8_t value) { Sim.digitalWrite(pin, value); }
+int analogRead(uint8_t pin) { return Sim.pin(pin).analogValue(Sim.now()); }
+void analogWrite(uint8_t pin, int value) { Sim.analogWrite(pin, value); }
+// Port access as on AVR: ports are numbered from 1 and hold 8 pins each.
+#define NOT_A_PIN 0
+#define NOT_A_PORT 0
+#define digitalPinToPort(pin) ((pin) < Simulator::NumPins ? ((pin) >> 3) + 1 : NOT_A_PIN)
+#define digitalPinToBitMask(pin) ((uint8_t)(1 << ((pin) & 7)))
+#define portInputRegister(port) (Sim.pinRegister((port) - 1))
+#define portOutputRegister(port) (Sim.portRegister((port) - 1))
+// Writing through the pointer above wouldn't move the simulated pins, so code that
+// writes whole ports calls this on the host instead.
+void hostWritePort(uint8_t port, uint8_t set, uint8_t clear) { Sim.writePort(port - 1, set, clear); }
+int digitalPinToInterrupt(uint8_t pin) { return pin < Simulator::NumPins ? pin : NOT_AN_INTERRUPT; }
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) { Sim.attachInterrupt(interrupt, isr, mode); }
+void detachInterrupt(uint8_t interrupt) { Sim.detachInterrupt(interrupt); }
+void noInterrupts() { Sim.interrupts(false); }
+void interrupts() { Sim.interrupts(true); }
+// SREG, with only the global interrupt bit (7) modelled.
+struct HostStatusRegister {
+	operator uint8_t() const { return Sim.interruptsEnabled() ? 0x80 : 0; }
+	HostStatusRegister &operator = (uint8_t value) { Sim.interrupts(value & 0x80); return *this; }
+};
+HostStatusRegister SREG;
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0) { Sim.tone(pin, frequency); }
+void noTone(uint8_t pin) { Sim.tone(pin, 0); }
+void randomSeed(unsigned long seed) { Sim.randomSeed(seed); }
+long random(long howBig) { return Sim.random(howBig); }
+long random(long howSmall, long howBig) {
+	if (howSmall >= howBig) return howSmall;
+	return howSmall + Sim.random(howBig - howSmall);
+}
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+	return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
 class String {
+	std::string _text;
 public:
-	String() { }
-	String(const char*) { }
-	String substring(int) { }
-	String &operator = (const char*) { return *this; }
-	String operator + (const char*) { }
-	operator const char* () { return NULL; }
-	void trim() { }
+	String(const char *text = "") : _text(text ? text : "") { }
+	String(const std::string &text) : _text(text) { }
+	String(char c) : _text(1, c) { }
+	String(int value, int base = DEC) : _text(format(value, base)) { }
+	String(long value, int base = DEC) : _text(format(value, base)) { }
+	String(unsigned int value, int base = DEC) : _text(format(value, base)) { }
+	String(unsigned long value, int base = DEC) : _text(format(value, base)) { }
+	const char *c_str() const { return _text.c_str(); }
+	unsigned int length() const { return _text.length(); }
+	char operator [] (unsigned int index) const { return index < _text.length() ? _text[index] : 0; }
+	char charAt(unsigned int index) const { return (*this)[index]; }
+	String substring(unsigned int from) const { return from < _text.length() ? String(_text.substr(from)) : String(); }
+	String substring(unsigned int from, unsigned int to) const {
+		return from < _text.length() && from < to ? String(_text.substr(from, to - from)) : String();
+	}
+	int indexOf(char c) const { size_t i = _text.find(c); return i == std::string::npos ? -1 : (int)i; }
+	long toInt() const { return atol(_text.c_str()); }
+	void trim() {
+		size_t first = _text.find_first_not_of(" \t\r\n");
+		size_t last = _text.find_last_not_of(" \t\r\n");
+		_text = (first == std::string::npos) ? "" : _text.substr(first, last - first + 1);
+	}
+	String &operator += (const String &other) { _text += other._text; return *this; }
+	friend String operator + (const String &a, const String &b) { return String(a._text + b._text); }
+	friend String operator + (const String &a, const char *b) { return String(a._text + b); }
+	bool operator == (const String &other) const { return _text == other._text; }
+	bool operator == (const char *other) const { return _text == other; }
+	bool operator != (const String &other) const { return _text != other._text; }
+	bool operator < (const String &other) const { return _text < other._text; }
+	static std::string format(unsigned long value, int base, bool negative = false) {
+		char buffer[72];
+		char *p = buffer + sizeof(buffer) - 1;
+		*p = 0;
+		do {
+			int digit = value % base;
+			*--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+			value /= base;
+		} while (value);
+		if (negative) *--p = '-';
+		return std::string(p);
+	}
+	static std::string format(long value, int base) {
+		if (value < 0 && base == DEC) return format((unsigned long)-value, base, true);
+		return format((unsigned long)value, base);
+	}
+	static std::string format(int value, int base) { return format((long)value, base); }
+	static std::string format(unsigned int value, int base) { return format((unsigned long)value, base); }
 };
-uint16_t SSD1306_WHITE = 0;
+
+/**
+ * Print is the host version of Arduino's Print: everything funnels into write().
+ */
+class Print {
+public:
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		for (size_t i = 0; i < size; i++) write(buffer[i]);
+		return size;
+	}
+	size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+	size_t print(const char *text) { return write(text); }
+	size_t print(const String &text) { return write(text.c_str()); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char value, int base = DEC) { return print(String((unsigned long)value, base)); }
+	size_t print(int value, int base = DEC) { return print(String((long)value, base)); }
+	size_t print(unsigned int value, int base = DEC) { return print(String((unsigned long)value, base)); }
+	size_t print(long value, int base = DEC) { return print(String(value, base)); }
+	size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+	size_t print(double value, int digits = 2) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+		return print(buffer);
+	}
+	size_t println() { return write("\r\n"); }
+	template <class T>
+	size_t println(T value) { size_t n = print(value); return n + println(); }
+	template <class T>
+	size_t println(T value, int base) { size_t n = print(value, base); return n + println(); }
+};
+
+/**
+ * HostSerial keeps everything printed (and echoes it to stdout), and hands back
+ * whatever has been queued with input() to available()/read()/readString().
+ */
+class HostSerial : public Print {
+	std::string _output;
+	std::string _input;
+	bool _echo;
+	bool _capture;
+public:
+	HostSerial() : _echo(true), _capture(true) { }
+	void begin(unsigned long baud) { }
+	void end() { }
+	operator bool() const { return true; }
+	size_t write(uint8_t c) {
+		if (_capture) _output += (char)c;
+		if (_echo) putchar(c);
+		return 1;
+	}
+	using Print::write;
+	void flush() { fflush(stdout); }
+	int available() const { return _input.size(); }
+	int read() {
+		if (_input.empty()) return -1;
+		int c = (uint8_t)_input[0];
+		_input.erase(0, 1);
+		return c;
+	}
+	String readString() {
+		String result(_input);
+		_input.clear();
+		return result;
+	}
+	// Simulation controls
+	void input(const char *text) { _input += text; }
+	void echo(bool value) { _echo = value; }
+	void capture(bool value) { _capture = value; }
+	const std::string &output() const { return _output; }
+	void clearOutput() { _output.clear(); }
+};
+
+HostSerial Serial;
+
+#define KEY_LEFT_CTRL 0x80
+#define KEY_LEFT_SHIFT 0x81
+#define KEY_LEFT_ALT 0x82
+#define KEY_RETURN 0xB0
+#define KEY_ESC 0xB1
+#define KEY_F1 0xC2
+#define KEY_F5 0xC6
+#define MOUSE_LEFT 1
+#define MOUSE_RIGHT 2
+#define MOUSE_MIDDLE 4
+
+class HostKeyboard {
+public:
+	void begin() { }
+	void end() { }
+	size_t press(uint8_t key) { Sim.hid('K', 'p', key); return 1; }
+	size_t release(uint8_t key) { Sim.hid('K', 'r', key); return 1; }
+	void releaseAll() { Sim.hid('K', 'R', 0); }
+	size_t write(uint8_t key) { press(key); release(key); return 1; }
+};
+
+class HostMouse {
+public:
+	void begin() { }
+	void end() { }
+	void press(uint8_t button = MOUSE_LEFT) { Sim.hid('M', 'p', button); }
+	void release(uint8_t button = MOUSE_LEFT) { Sim.hid('M', 'r', button); }
+	void click(uint8_t button = MOUSE_LEFT) { Sim.hid('M', 'c', button); }
+	void move(signed char x, signed char y, signed char wheel = 0) { Sim.hid('M', 'm', wheel, x, y); }
+};
+
+HostKeyboard Keyboard;
+HostMouse Mouse;
+
+/**
+ * Things on the host's I2C bus.  A device attached to Wire at an address gets every
+ * transmission sent to that address, as written between beginTransmission() and
+ * endTransmission().  Transmissions take time, like they do on a board:
+ * endTransmission() moves the clock on by 9 bits per byte (address included) at
+ * the setClock() rate, so a long transfer shows up as a slow pass.
+ */
+class HostI2CDevice {
+public:
+	virtual void receive(const uint8_t *data, size_t size) = 0;
+};
+
+class TwoWire {
+	unsigned long _bytes;
+	unsigned long _transmissions;
+	HostI2CDevice *_devices[128];
+	uint8_t _address;
+	std::vector<uint8_t> _pending;
+	unsigned long _clock;
+public:
+	TwoWire() : _bytes(0), _transmissions(0), _address(0), _clock(100000UL) {
+		memset(_devices, 0, sizeof(_devices));
+	}
+	void begin() { }
+	void setClock(unsigned long clock) { _clock = clock; }
+	void beginTransmission(uint8_t address) {
+		_transmissions++;
+		_address = address & 0x7F;
+		_pending.clear();
+	}
+	size_t write(uint8_t data) { _bytes++; _pending.push_back(data); return 1; }
+	size_t write(const uint8_t *data, size_t size) {
+		_bytes += size;
+		_pending.insert(_pending.end(), data, data + size);
+		return size;
+	}
+	uint8_t endTransmission(bool stop = true) {
+		Sim.advance((uint64_t)(_pending.size() + 1) * 9 * 1000000UL / _clock);
+		HostI2CDevice *device = _devices[_address];
+		if (device == NULL) {
+			return 2; // NACK on address, same as the real thing
+		}
+		device->receive(_pending.data(), _pending.size());
+		return 0;
+	}
+	void attach(uint8_t address, HostI2CDevice *device) { _devices[address & 0x7F] = device; }
+	unsigned long bytes() const { return _bytes; }
+	unsigned long transmissions() const { return _transmissions; }
+};
+
+TwoWire Wire;
+
+class SPIClass {
+public:
+	void begin() { }
+};
+
+SPIClass SPI;
+
+typedef struct { } GFXfont;
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_MEMORYMODE 0x20
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+
+/**
+ * Adafruit_GFX for the host.  Same shape as the real one: drawPixel() is the only
+ * thing a display has to provide and everything else is built on it, with the
+ * line/rect/fill primitives virtual so displays can speed them up.  There's no font,
+ * so text is drawn as a solid 5x7 block per character (enough to see where it went).
+ */
+class Adafruit_GFX : public Print {
+protected:
+	int16_t _width;
+	int16_t _height;
+	int16_t cursor_x;
+	int16_t cursor_y;
+	uint16_t textcolor;
+	uint16_t textbgcolor;
+	uint8_t textsize;
+public:
+	Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h), cursor_x(0), cursor_y(0),
+		textcolor(1), textbgcolor(1), textsize(1) { }
+	virtual ~Adafruit_GFX() { }
+	virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+	virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+		for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color);
+	}
+	virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+		for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color);
+	}
+	virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+		for (int16_t i = 0; i < w; i++) drawFastVLine(x + i, y, h, color);
+	}
+	virtual void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+	virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+		if (x0 == x1) {
+			drawFastVLine(x0, min(y0, y1), abs(y1 - y0) + 1, color);
+			return;
+		}
+		if (y0 == y1) {
+			drawFastHLine(min(x0, x1), y0, abs(x1 - x0) + 1, color);
+			return;
+		}
+		int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+		int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+		int16_t err = dx + dy;
+		for (;;) {
+			drawPixel(x0, y0, color);
+			if (x0 == x1 && y0 == y1) break;
+			int16_t e2 = 2 * err;
+			if (e2 >= dy) { err += dy; x0 += sx; }
+			if (e2 <= dx) { err += dx; y0 += sy; }
+		}
+	}
+	virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+		drawFastHLine(x, y, w, color);
+		drawFastHLine(x, y + h - 1, w, color);
+		drawFastVLine(x, y, h, color);
+		drawFastVLine(x + w - 1, y, h, color);
+	}
+	void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+		int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+		drawPixel(x0, y0 + r, color);
+		drawPixel(x0, y0 - r, color);
+		drawPixel(x0 + r, y0, color);
+		drawPixel(x0 - r, y0, color);
+		while (x < y) {
+			if (f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+			x++;
+			ddF_x += 2;
+			f += ddF_x;
+			drawPixel(x0 + x, y0 + y, color);
+			drawPixel(x0 - x, y0 + y, color);
+			drawPixel(x0 + x, y0 - y, color);
+			drawPixel(x0 - x, y0 - y, color);
+			drawPixel(x0 + y, y0 + x, color);
+			drawPixel(x0 - y, y0 + x, color);
+			drawPixel(x0 + y, y0 - x, color);
+			drawPixel(x0 - y, y0 - x, color);
+		}
+	}
+	void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+		drawFastVLine(x0, y0 - r, 2 * r + 1, color);
+		int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+		while (x < y) {
+			if (f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+			x++;
+			ddF_x += 2;
+			f += ddF_x;
+			drawFastVLine(x0 + x, y0 - y, 2 * y + 1, color);
+			drawFastVLine(x0 - x, y0 - y, 2 * y + 1, color);
+			drawFastVLine(x0 + y, y0 - x, 2 * x + 1, color);
+			drawFastVLine(x0 - y, y0 - x, 2 * x + 1, color);
+		}
+	}
+	void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color) {
+		int16_t byteWidth = (w + 7) / 8;
+		for (int16_t j = 0; j < h; j++) {
+			for (int16_t i = 0; i < w; i++) {
+				if (pgm_read_byte(bitmap + j * byteWidth + i / 8) & (0x80 >> (i & 7))) {
+					drawPixel(x + i, y + j, color);
+				}
+			}
+		}
+	}
+	void setFont(const GFXfont *font = NULL) { }
+	void setTextSize(uint8_t size) { textsize = size ? size : 1; }
+	void setTextColor(uint16_t color) { textcolor = textbgcolor = color; }
+	void setTextColor(uint16_t color, uint16_t background) { textcolor = color; textbgcolor = background; }
+	void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+	int16_t getCursorX() const { return cursor_x; }
+	int16_t getCursorY() const { return cursor_y; }
+	void getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+		*x1 = x;
+		*y1 = y;
+		*w = strlen(text) * 6 * textsize;
+		*h = 8 * textsize;
+	}
+	size_t write(uint8_t c) {
+		if (c == '\n') {
+			cursor_x = 0;
+			cursor_y += 8 * textsize;
+		} else if (c != '\r') {
+			if (textbgcolor != textcolor) {
+				fillRect(cursor_x, cursor_y, 6 * textsize, 8 * textsize, textbgcolor);
+			}
+			if (c != ' ') {
+				fillRect(cursor_x, cursor_y, 5 * textsize, 7 * textsize, textcolor);
+			}
+			cursor_x += 6 * textsize;
+		}
+		return 1;
+	}
+	using Print::write;
+	int16_t width() const { return _width; }
+	int16_t height() const { return _height; }
+};
+
+class Adafruit_GFX_Button {
+	Adafruit_GFX *_gfx;
+	int16_t _x1, _y1;
+	uint16_t _w, _h;
+	uint16_t _outline, _fill, _text;
+	uint8_t _textsize;
+	char _label[10];
+	bool _state, _lastState;
+public:
+	Adafruit_GFX_Button() : _gfx(NULL), _state(false), _lastState(false) { }
+	void initButtonUL(Adafruit_GFX *gfx, int16_t x1, int16_t y1, uint16_t w, uint16_t h,
+		uint16_t outline, uint16_t fill, uint16_t textcolor, char *label, uint8_t textsize) {
+		_gfx = gfx; _x1 = x1; _y1 = y1; _w = w; _h = h;
+		_outline = outline; _fill = fill; _text = textcolor; _textsize = textsize;
+		strncpy(_label, label, sizeof(_label) - 1);
+		_label[sizeof(_label) - 1] = 0;
+	}
+	void drawButton(bool inverted = false) {
+		_gfx->fillRect(_x1, _y1, _w, _h, inverted ? _text : _fill);
+		_gfx->drawRect(_x1, _y1, _w, _h, _outline);
+		_gfx->setCursor(_x1 + _w / 2 - strlen(_label) * 3 * _textsize, _y1 + _h / 2 - 4 * _textsize);
+		_gfx->setTextSize(_textsize);
+		_gfx->setTextColor(inverted ? _fill : _text);
+		_gfx->print(_label);
+	}
+	bool contains(int16_t x, int16_t y) { return x >= _x1 && x < _x1 + _w && y >= _y1 && y < _y1 + _h; }
+	void press(bool pressed) { _lastState = _state; _state = pressed; }
+	bool isPressed() { return _state; }
+	bool justPressed() { return _state && !_lastState; }
+	bool justReleased() { return !_state && _lastState; }
+};
+
+/**
+ * Adafruit_SSD1306 for the host.  It keeps the same page-packed buffer as the real
+ * driver (one byte = 8 vertical pixels) and talks to the panel the same way, over
+ * Wire: a control byte of 0x00 for commands or 0x40 for data, the window set with
+ * SSD1306_COLUMNADDR/SSD1306_PAGEADDR, and data in 32 byte transmissions.  The panel
+ * end is modelled too, so frame() is what the display RAM holds, however it got
+ * there, and frames() counts display() calls.
+ */
+class Adafruit_SSD1306 : public Adafruit_GFX, private HostI2CDevice {
+	uint8_t *_buffer;
+	TwoWire *_wire;
+	uint8_t _address;
+	std::vector<uint8_t> _frame;
+	unsigned long _frames;
+	// Panel state: the address window and where the next data byte goes.
+	uint8_t _command;
+	uint8_t _args[2];
+	uint8_t _argCount;
+	uint8_t _column0, _column1, _page0, _page1;
+	uint8_t _column, _page;
+public:
+	Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *wire = &Wire, int8_t resetPin = -1) :
+		Adafruit_GFX(w, h), _buffer(new uint8_t[w * ((h + 7) / 8)]), _wire(wire), _address(0x3C),
+		_frame(w * ((h + 7) / 8)), _frames(0), _command(0), _argCount(0),
+		_column0(0), _column1(w - 1), _page0(0), _page1((h + 7) / 8 - 1), _column(0), _page(0) {
+		clearDisplay();
+		_wire->attach(_address, this);
+	}
+	~Adafruit_SSD1306() { delete [] _buffer; }
+	bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t address = 0x3C, bool reset = true, bool periphBegin = true) {
+		_wire->attach(_address, NULL);
+		_address = address;
+		_wire->attach(_address, this);
+		return true;
+	}
+	void drawPixel(int16_t x, int16_t y, uint16_t color) {
+		if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+		uint8_t &b = _buffer[x + (y / 8) * _width];
+		uint8_t bit = 1 << (y & 7);
+		switch (color) {
+		case SSD1306_WHITE: b |= bit; break;
+		case SSD1306_BLACK: b &= ~bit; break;
+		case SSD1306_INVERSE: b ^= bit; break;
+		}
+	}
+	bool getPixel(int16_t x, int16_t y) const {
+		if (x < 0 || y < 0 || x >= _width || y >= _height) return false;
+		return (_buffer[x + (y / 8) * _width] >> (y & 7)) & 1;
+	}
+	void clearDisplay() { memset(_buffer, 0, bufferSize()); }
+	void display() {
+		static const uint8_t window[] = { 0x00, SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0 };
+		_wire->setClock(400000UL);
+		_wire->beginTransmission(_address);
+		_wire->write(window, sizeof(window));
+		_wire->write((uint8_t)(_width - 1));
+		_wire->endTransmission();
+		for (size_t sent = 0; sent < bufferSize(); ) {
+			size_t chunk = min((size_t)31, bufferSize() - sent);
+			_wire->beginTransmission(_address);
+			_wire->write((uint8_t)0x40);
+			_wire->write(_buffer + sent, chunk);
+			_wire->endTransmission();
+			sent += chunk;
+		}
+		_wire->setClock(100000UL);
+		_frames++;
+	}
+	void ssd1306_command(uint8_t c) {
+		_wire->beginTransmission(_address);
+		_wire->write((uint8_t)0x00);
+		_wire->write(c);
+		_wire->endTransmission();
+	}
+	void invertDisplay(bool invert) { }
+	void dim(bool dim) { }
+	uint8_t *getBuffer() { return _buffer; }
+	size_t bufferSize() const { return _width * ((_height + 7) / 8); }
+	unsigned long frames() const { return _frames; }
+	const std::vector<uint8_t> &frame() const { return _frame; }
+private:
+	void receive(const uint8_t *data, size_t size) {
+		if (size == 0) return;
+		bool isData = data[0] & 0x40;
+		for (size_t i = 1; i < size; i++) {
+			if (isData) {
+				store(data[i]);
+			} else {
+				command(data[i]);
+			}
+		}
+	}
+	void command(uint8_t c) {
+		if (_argCount == 0) {
+			_command = c;
+			// Only the addressing commands matter here; the rest just need their
+			// arguments skipped.
+			switch (c) {
+			case SSD1306_COLUMNADDR: case SSD1306_PAGEADDR: _argCount = 2; break;
+			case SSD1306_MEMORYMODE: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+			case 0xD5: case 0xD9: case 0xDA: case 0xDB: _argCount = 1; break;
+			}
+			return;
+		}
+		_args[(_command == SSD1306_COLUMNADDR || _command == SSD1306_PAGEADDR) ? 2 - _argCount : 0] = c;
+		if (--_argCount == 0) {
+			uint8_t pages = (_height + 7) / 8;
+			if (_command == SSD1306_COLUMNADDR) {
+				_column0 = _column = min(_args[0], (uint8_t)(_width - 1));
+				_column1 = min(_args[1], (uint8_t)(_width - 1));
+			} else if (_command == SSD1306_PAGEADDR) {
+				_page0 = _page = min(_args[0], (uint8_t)(pages - 1));
+				_page1 = min(_args[1], (uint8_t)(pages - 1));
+			}
+		}
+	}
+	void store(uint8_t b) {
+		_frame[_column + _page * _width] = b;
+		if (_column++ == _column1) {
+			_column = _column0;
+			_page = _page == _page1 ? _page0 : _page + 1;
+		}
+	}
+};
+
+#ifdef HOST_MAIN
+void setup();
+void loop();
+
+int main(int argc, char **argv) {
+	long passes = argc > 1 ? atol(argv[1]) : 1000000L;
+	long microsPerPass = argc > 2 ? atol(argv[2]) : 10;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	setup();
+	for (long i = 0; i < passes; i++) {
+		loop();
+		Sim.advance(microsPerPass);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fflush(stdout);
+	fprintf(stderr, "%ld passes, %.3f simulated s, %.3f real s, %.0f passes/s\n",
+		passes, Sim.now() / 1e6, seconds, seconds > 0 ? passes / seconds : 0.0);
+	return 0;
+}
+#endif
+
 #endif
@@ -34,14 +34,14 @@ Note: the PWM pins on the Pro Micro are 3, 5, 6, 9, 10.
 */
 
 struct {
-  const LedConfig DefaultLed = { .pin = 17, .lowIsOn = true };
+  const LedConfig DefaultLed = { /* pin */ 17, /* lowIsOn */ true };
   struct {
-    const ButtonConfig Button = { .pin = 4, .lowIsPressed = true };
-    const EncoderConfig Encoder = { .clockPin = 6, .dataPin = 5 };
+    const ButtonConfig Button = { /* pin */ 4, /* lowIsPressed */ true };
+    const EncoderConfig Encoder = { /* clockPin */ 6, /* dataPin */ 5 };
   } Left;
   struct {
-    const ButtonConfig Button = { .pin = 7, .lowIsPressed = true };
-    const EncoderConfig Encoder = { .clockPin = 9, .dataPin = 8 };
+    const ButtonConfig Button = { /* pin */ 7, /* lowIsPressed */ true };
+    const EncoderConfig Encoder = { /* clockPin */ 9, /* dataPin */ 8 };
   } Right;
 } Config;
 
@@ -29,6 +29,7 @@ SOFTWARE.
 #include <EdgeDetector.hpp>
 #include <PinIO.hpp>
 #include <Mapper.hpp>
+#include <Debouncer.hpp>
 
 /*
 Button and ButtonHandler monitors a pushbutton (or switch) and provides
@@ -45,27 +46,47 @@ void setup() {
 void loop() { schedule.poll(); }
 */
 
+const int DefaultDebounceMs = 5;
+
 struct ButtonConfig {
 	int pin;
 	bool lowIsPressed;
-	ButtonConfig(int pinValue, bool lowIsPressedValue) :
-		pin(pinValue), lowIsPressed(lowIsPressedValue) { }
+	int debounceMs;
+	ButtonConfig(int pinValue, bool lowIsPressedValue, int debounceMsValue = DefaultDebounceMs) :
+		pin(pinValue), lowIsPressed(lowIsPressedValue), debounceMs(debounceMsValue) { }
 };
 
 /**
  * ButonValue reads a pushbutton and normalizes the signal such that regardless
  * of the hardware, the button's "value" is HIGH when pressed and LOW when released.
  * Use the input `pulledLowOnPress` to invert a hardware button if that's the case.
+ * It's debounced by the schedule's ButtonBank: a press or release has to hold for
+ * debounceMs (1 to 16) before the value follows.  On a schedule without passes, or
+ * past 32 buttons, it reads the pin as it is.
  */
-class ButtonValue : private DigitalRead, private Inverter {
-	bool _rawValue;
+class ButtonValue : private Scheduled {
+	bool &_value;
+	const int _pin;
+	const bool _pulledLowOnPress;
+	ButtonBank *_bank;
+	int _bit;
 public:
 	ButtonValue(Schedule &schedule, const ButtonConfig &config, bool &value) :
-		ButtonValue(schedule, config.pin, config.lowIsPressed, value) { }
-	ButtonValue(Schedule &schedule, int pin, bool pulledLowOnPress, bool &value) :
-		DigitalRead(schedule, pin, _rawValue, pinMode(pulledLowOnPress)),
-		Inverter(schedule, _rawValue, value, pulledLowOnPress),
-		_rawValue(pulledLowOnPress) { }
+		ButtonValue(schedule, config.pin, config.lowIsPressed, value, config.debounceMs) { }
+	ButtonValue(Schedule &schedule, int pin, bool pulledLowOnPress, bool &value, int debounceMs = DefaultDebounceMs) :
+		Scheduled(schedule), _value(value), _pin(pin), _pulledLowOnPress(pulledLowOnPress) {
+		::pinMode(pin, pinMode(pulledLowOnPress));
+		_bank = ButtonBank::of(schedule);
+		_bit = _bank ? _bank->add(pin, pulledLowOnPress, debounceMs) : -1;
+		poll();
+	}
+	void poll() {
+		if (_bit < 0) {
+			_value = digitalRead(_pin) != _pulledLowOnPress;
+		} else {
+			_value = _bank->pressed(_bit);
+		}
+	}
 private:
 	static int pinMode(bool pulledLowOnPress) {
 		if (pulledLowOnPress) return INPUT_PULLUP;
@@ -81,25 +102,24 @@ class ButtonHandler : private ButtonValue, private EdgeDetector {
 	bool _value;
 public:
 	ButtonHandler(Schedule &schedule, const ButtonConfig &config, void (*pressHandler)(), void (*releaseHandler)() = 0) :
-		ButtonHandler(schedule, config.pin, config.lowIsPressed, pressHandler, releaseHandler) { }
+		ButtonValue(schedule, config, _value),
+		EdgeDetector(schedule, _value, pressHandler, releaseHandler) { }
 	ButtonHandler(Schedule &schedule, int pin, bool pulledLowOnPress, void (*pressHandler)(), void (*releaseHandler)() = 0) :
 		ButtonValue(schedule, pin, pulledLowOnPress, _value),
-		EdgeDetector(schedule, _value, pressHandler, releaseHandler),
-		_value(LOW) { }
+		EdgeDetector(schedule, _value, pressHandler, releaseHandler) { }
 };
 
 /**
  * Button transfers the pressing of a physical button pressing to a Pressable object's press/release methods.
  */
-class Button : private EdgeDetectorBase, private ButtonValue {
+class Button : private ButtonValue, private EdgeDetectorBase {
 	Pressable &_button;
 	bool _value;
 public:
 	Button(Schedule &schedule, const ButtonConfig &config, Pressable &button) :
-		Button(schedule, config.pin, config.lowIsPressed, button) { }
+		ButtonValue(schedule, config, _value), EdgeDetectorBase(schedule, _value), _button(button) { }
 	Button(Schedule &schedule, int pin, bool pulledLowOnPress, Pressable &button) :
-		ButtonValue(schedule, pin, pulledLowOnPress, _value),
-		EdgeDetectorBase(schedule, _value), _button(button), _value(LOW) { }
+		ButtonValue(schedule, pin, pulledLowOnPress, _value), EdgeDetectorBase(schedule, _value), _button(button) { }
 	void onRisingEdge() {
 		_button.press();
 	}
@@ -113,7 +133,7 @@ class ToggleButton : private Button, private Pressable {
 	Enabled &_control;
 public:
 	ToggleButton(Schedule &schedule, const ButtonConfig &config, Enabled &control) :
-		ToggleButton(schedule, config.pin, config.lowIsPressed, control) { }
+		Button(schedule, config, *this), _control(control) { }
 	ToggleButton(Schedule &schedule, int pin, bool pulledLowOnPress, Enabled &control) :
 		Button(schedule, pin, pulledLowOnPress, *this), _control(control) { }
 	void press() { _control.toggle(); }
@@ -65,6 +65,36 @@ public:
 		_time = constrain(time, 0, MAX_LONG);
 		_lastExpired = millis();
 	}
+	bool off() const { return _time == MAX_LONG; }
+	// The first millis() value at which expired() is true.
+	unsigned long due() const { return (unsigned long)_lastExpired + (unsigned long)_time + 1; }
+};
+
+/*
+ScheduledTimer is a Timer that waits in the schedule's deadline queue instead of
+being polled, so it costs nothing until it's due.  onExpired() is called once the
+time is up; call reset() from there to go again.  A timer set to MAX_LONG is off
+and isn't queued at all.
+*/
+class ScheduledTimer : private Deadline, public Timer {
+	DeadlineQueue &_queue;
+public:
+	ScheduledTimer(Schedule &schedule, long time) : Timer(time), _queue(schedule.deadlines()) {
+		reset(time);
+	}
+	void reset(long time) {
+		Timer::reset(time);
+		if (off()) {
+			cancel();
+		} else {
+			_queue.schedule(this, due());
+		}
+	}
+	void cancel() { _queue.cancel(this); }
+	using Deadline::queued;
+	virtual void onExpired() = 0;
+private:
+	void onDue() { onExpired(); }
 };
 
 class ExpiresComposite : public Composite<Expires> {
@@ -73,11 +103,12 @@ public:
 	ExpiresComposite(bool any = true, Expires *itemsZ[] = NULL) :
 		Composite<Expires>(itemsZ, countZ(itemsZ)), _any(any) { }
 	bool expired() const {
-		for (int i = 0; i < length(); i++) {
-			if (item(i)->expired() && _any) {
+		for (Iterator i = items(); !i.done(); i.next()) {
+			bool expired = i.current()->expired();
+			if (expired && _any) {
 				return true;
 			}
-			if (!item(i)->expired() && !_any) {
+			if (!expired && !_any) {
 				return false;
 			}
 		}
@@ -85,49 +116,57 @@ public:
 	}
 };
 
-class PeriodicBase : private Scheduled, public Enabled, public Timer {
+class PeriodicBase : public Enabled, public ScheduledTimer {
 	bool _enabled = true;
 	long &_period;
 public:
-	PeriodicBase(Schedule &schedule, long &period) : Scheduled(schedule), Timer(period), _period(period) { }
-	void poll() {
-		if (expired() && _enabled) {
+	PeriodicBase(Schedule &schedule, long &period) : ScheduledTimer(schedule, period), _period(period) { }
+	void onExpired() {
+		// While disabled the timer is left to lapse; enable() picks it back up.
+		if (_enabled) {
 			reset(_period);
 			handleExpired();
 		}
 	}
-	void enable(bool value) { _enabled = value; }
+	void enable(bool value) {
+		_enabled = value;
+		if (_enabled && !queued()) {
+			reset(0);
+		}
+	}
 	void toggle() { enable(!_enabled); }
 	virtual void handleExpired() = 0;
 };
 
-class Clock : private Scheduled, private Timer, public Enabled {
+class Clock : private ScheduledTimer, public Enabled {
 	long &_lowTime;
 	long &_highTime;
 	bool &_value;
 	bool _enabled = true;
 public:
 	Clock(Schedule &schedule, long &lowTime, long &highTime, bool &value) :
-		Scheduled(schedule), Timer(lowTime), _lowTime(lowTime), _highTime(highTime), _value(value) { }
+		ScheduledTimer(schedule, lowTime), _lowTime(lowTime), _highTime(highTime), _value(value) { }
 	void enable(bool value) {
 		if (_enabled != value) {
 			_enabled = value;
 			_value = LOW;
-			reset(0);
+			if (_enabled) {
+				reset(0);
+			} else {
+				cancel();
+			}
 		}
 	}
 	void toggle() {
 		enable(!_enabled);
 	}
-	void poll() {
-		if (expired() && _enabled) {
-			if (_value) {
-				_value = LOW;
-				reset(_lowTime);
-			} else {
-				_value = HIGH;
-				reset(_highTime);
-			}
+	void onExpired() {
+		if (_value) {
+			_value = LOW;
+			reset(_lowTime);
+		} else {
+			_value = HIGH;
+			reset(_highTime);
 		}
 	}
 };
@@ -148,4 +187,164 @@ public:
 	}
 };
 
+/*
+ProfiledSchedule is a MainSchedule that times every poller with micros(), for when
+SpeedTest says the loop is slow and you need to know who to blame.  Call report() to
+print a table ranked by total time (count, min, max and mean microseconds per
+poller, numbered in the order they were added), followed by a histogram of how long
+whole passes took.  The deadline queue shows up as its own row, and so do the pass
+hooks (the PortLatch flush, say) as "hooks".
+
+It only does any of this when PROFILE_SCHEDULE is defined; otherwise it's just a
+MainSchedule and report() compiles to nothing.
+
+Example:
+#define PROFILE_SCHEDULE
+ProfiledSchedule schedule;
+ButtonHandler dump(schedule, 4, true, &onDump);
+void onDump() { schedule.report(); }
+*/
+#ifdef PROFILE_SCHEDULE
+
+class PollerProfile : public Poller {
+public:
+	// Indexes for the rows that aren't pollers.
+	static const int Deadlines = -1;
+	static const int Hooks = -2;
+private:
+	Poller *_poller;
+	const int _index;
+	unsigned long _count;
+	unsigned long _total;
+	unsigned long _min;
+	unsigned long _max;
+	bool _reported;
+public:
+	PollerProfile(Poller *poller, int index) : _poller(poller), _index(index), _reported(false) { reset(); }
+	void poll() {
+		unsigned long start = micros();
+		_poller->poll();
+		record(micros() - start);
+	}
+	void record(unsigned long time) {
+		_count++;
+		_total += time;
+		if (time < _min) _min = time;
+		if (time > _max) _max = time;
+	}
+	void reset() { _count = 0; _total = 0; _min = MAX_ULONG; _max = 0; }
+	unsigned long total() const { return _total; }
+	bool reported() const { return _reported; }
+	void clearReported() { _reported = false; }
+	void print() {
+		_reported = true;
+		if (_index == Deadlines) {
+			Serial.print("deadlines");
+		} else if (_index == Hooks) {
+			Serial.print("hooks");
+		} else {
+			Serial.print((long)_index, DEC);
+		}
+		Serial.print(",");
+		Serial.print((long)_count, DEC);
+		Serial.print(",");
+		Serial.print((long)(_count ? _min : 0), DEC);
+		Serial.print(",");
+		Serial.print((long)_max, DEC);
+		Serial.print(",");
+		Serial.print((long)(_count ? _total / _count : 0), DEC);
+		Serial.print(",");
+		Serial.println((long)_total, DEC);
+	}
+};
+
+class ProfiledSchedule : public MainSchedule {
+	// Pass times in buckets of < 16, 64, 256, 1024, 4096 and >= 4096 microseconds.
+	static const int Buckets = 6;
+	unsigned long _histogram[Buckets];
+	PollerProfile _deadlines;
+	PollerProfile _hooks;
+public:
+	ProfiledSchedule() : _deadlines(NULL, PollerProfile::Deadlines), _hooks(NULL, PollerProfile::Hooks) { reset(); }
+	void add(Poller *item) {
+		MainSchedule::add(new PollerProfile(item, length()));
+	}
+	void poll() {
+		unsigned long start = micros();
+		beginPass();
+		unsigned long hooks = micros() - start;
+		for (Iterator i = items(); !i.done(); i.next()) {
+			i.current()->poll();
+		}
+		unsigned long deadlineStart = micros();
+		deadlines().poll(millis());
+		unsigned long deadlineEnd = micros();
+		endPass();
+		unsigned long end = micros();
+		_deadlines.record(deadlineEnd - deadlineStart);
+		_hooks.record(hooks + end - deadlineEnd);
+		unsigned long time = end - start;
+		int bucket = 0;
+		for (unsigned long limit = 16; bucket < Buckets - 1 && time >= limit; limit <<= 2) {
+			bucket++;
+		}
+		_histogram[bucket]++;
+	}
+	void reset() {
+		for (int i = 0; i < Buckets; i++) {
+			_histogram[i] = 0;
+		}
+		_deadlines.reset();
+		_hooks.reset();
+		for (Iterator i = items(); !i.done(); i.next()) {
+			profile(i.current())->reset();
+		}
+	}
+	void report() {
+		Serial.println("poller,count,minUs,maxUs,meanUs,totalUs");
+		// Selection by descending total; it's only a report so O(n^2) is fine.
+		for (int printed = 0; printed < length() + 2; printed++) {
+			PollerProfile *next = _deadlines.reported() ? NULL : &_deadlines;
+			if (!_hooks.reported() && (next == NULL || _hooks.total() > next->total())) {
+				next = &_hooks;
+			}
+			for (Iterator i = items(); !i.done(); i.next()) {
+				PollerProfile *candidate = profile(i.current());
+				if (!candidate->reported() && (next == NULL || candidate->total() > next->total())) {
+					next = candidate;
+				}
+			}
+			next->print();
+		}
+		_deadlines.clearReported();
+		_hooks.clearReported();
+		for (Iterator i = items(); !i.done(); i.next()) {
+			profile(i.current())->clearReported();
+		}
+		Serial.print("passUs");
+		unsigned long limitUs = 16;
+		for (int i = 0; i < Buckets; i++) {
+			Serial.print(i < Buckets - 1 ? ",<" : ",>=");
+			Serial.print((long)(i < Buckets - 1 ? limitUs : limitUs >> 2), DEC);
+			Serial.print(":");
+			Serial.print((long)_histogram[i], DEC);
+			limitUs <<= 2;
+		}
+		Serial.println();
+	}
+private:
+	// Everything in the list went in through add(), so it's a PollerProfile.
+	static PollerProfile *profile(Poller *item) { return static_cast<PollerProfile*>(item); }
+};
+
+#else
+
+class ProfiledSchedule : public MainSchedule {
+public:
+	void reset() { }
+	void report() { }
+};
+
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,187 @@
+/*
+MIT License
+
+Copyright (c) 2022 jffordem
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef DEBOUNCER_HPP
+#define DEBOUNCER_HPP
+
+#include <Scheduler.hpp>
+#include <PinIO.hpp>
+
+/*
+Debouncer debounces a whole word of inputs at once (8, 16 or 32 with uint8_t,
+uint16_t or uint32_t) using vertical counters: bit n of each of the Planes counter
+words together make up button n's counter, so every button is counted down with the
+same few bitwise operations whether one of them is in use or all of them are.
+
+A button's debounced state only changes once its input has disagreed with it for
+ticks samples in a row; any sample that agrees starts it over.  ticks can be set per
+button, from 1 up to 2^Planes (16 by default).
+
+update() takes one sample per tick and returns the bits that changed.  pressed() and
+released() are the ones that went HIGH and LOW on that tick.
+
+Example:
+Debouncer<uint8_t> keys;
+keys.setTicks(0, 5);
+uint8_t changed = keys.update(PINB);
+if (keys.pressed() & 1) ...
+*/
+template <class T, int Planes = 4>
+class Debouncer {
+	T _state;
+	T _count[Planes];
+	T _reload[Planes];
+	T _pressed;
+	T _released;
+public:
+	Debouncer() : _state(0), _pressed(0), _released(0) {
+		for (int i = 0; i < Planes; i++) {
+			_count[i] = 0;
+			_reload[i] = 0;
+		}
+	}
+	static int maxTicks() { return 1 << Planes; }
+	void setTicks(int bit, int ticks) {
+		T mask = (T)1 << bit;
+		int reload = constrain(ticks, 1, maxTicks()) - 1;
+		for (int i = 0; i < Planes; i++) {
+			if ((reload >> i) & 1) {
+				_reload[i] |= mask;
+			} else {
+				_reload[i] &= ~mask;
+			}
+			_count[i] = (_count[i] & ~mask) | (_reload[i] & mask);
+		}
+	}
+	// Take the given bits as already settled, without reporting them as changes.
+	void reset(T state, T mask = ~(T)0) {
+		_state = (_state & ~mask) | (state & mask);
+	}
+	T update(T sample) {
+		T delta = sample ^ _state;
+		// Counters of bits that agree with the state go back to their reload value;
+		// the rest count down, and those already at zero change state.
+		T zero = ~(T)0;
+		for (int i = 0; i < Planes; i++) {
+			_count[i] = (_count[i] & delta) | (_reload[i] & ~delta);
+			zero &= ~_count[i];
+		}
+		T toggle = delta & zero;
+		T borrow = delta & ~zero;
+		for (int i = 0; i < Planes; i++) {
+			T count = _count[i];
+			// A bit that just changed starts a full count, so it has to settle again.
+			_count[i] = ((count ^ borrow) & ~toggle) | (_reload[i] & toggle);
+			borrow &= ~count;
+		}
+		_state ^= toggle;
+		_pressed = toggle & _state;
+		_released = toggle & ~_state;
+		return toggle;
+	}
+	T state() const { return _state; }
+	T pressed() const { return _pressed; }
+	T released() const { return _released; }
+};
+
+/*
+ButtonBank debounces up to 32 buttons on a schedule with one Debouncer.  Once a
+millisecond (so a tick is 1ms and ticks are milliseconds) it gathers the buttons'
+pins from the PortSnapshot into one word and updates the debouncer.  ButtonValue
+(and so Button, ButtonHandler and ToggleButton) find or make the one for their
+schedule, so there's nothing to set up; declare one to keep it off the heap:
+ButtonBank buttons(schedule);
+
+pressed() and released() are the edge masks from the last tick, and ticks() counts
+ticks, so something polling several buttons at once can tell a new mask from one
+it's already seen.
+*/
+class ButtonBank : public PassHook {
+	static const int MaxButtons = 32;
+	Debouncer<uint32_t> _debouncer;
+	PortSnapshot *_ports;
+	int8_t _port[MaxButtons];
+	uint8_t _mask[MaxButtons];
+	uint8_t _pin[MaxButtons];
+	int _count;
+	uint32_t _inverted;
+	unsigned long _lastTick;
+	unsigned long _ticks;
+	uint32_t sample() const {
+		uint32_t result = 0;
+		for (int i = 0; i < _count; i++) {
+			bool level = _port[i] < 0 ? digitalRead(_pin[i]) : _ports->read(_port[i], _mask[i]);
+			if (level) {
+				result |= (uint32_t)1 << i;
+			}
+		}
+		return result ^ _inverted;
+	}
+public:
+	static const int Kind = 'B';
+	ButtonBank(Schedule &schedule) : _count(0), _inverted(0), _lastTick(millis()), _ticks(0) {
+		_ports = PortSnapshot::of(schedule);
+		schedule.addHook(this);
+	}
+	static ButtonBank *of(Schedule &schedule) {
+		if (!schedule.hasPasses()) {
+			return NULL;
+		}
+		PassHook *hook = schedule.findHook(Kind);
+		return hook ? static_cast<ButtonBank*>(hook) : new ButtonBank(schedule);
+	}
+	int kind() const { return Kind; }
+	// The button's bit, or -1 if the bank is full.  The pin's mode should already be set.
+	int add(int pin, bool lowIsPressed, int debounceMs) {
+		if (_count == MaxButtons) {
+			return -1;
+		}
+		int bit = _count++;
+		_pin[bit] = pin;
+		_port[bit] = _ports ? _ports->watch(pin) : -1;
+		_mask[bit] = _port[bit] < 0 ? 0 : digitalPinToBitMask(pin);
+		if (lowIsPressed) {
+			_inverted |= (uint32_t)1 << bit;
+		}
+		_debouncer.setTicks(bit, debounceMs);
+		_debouncer.reset((digitalRead(pin) ? (uint32_t)1 << bit : 0) ^ (_inverted & ((uint32_t)1 << bit)),
+			(uint32_t)1 << bit);
+		return bit;
+	}
+	bool pressed(int bit) const { return (_debouncer.state() >> bit) & 1; }
+	uint32_t state() const { return _debouncer.state(); }
+	uint32_t pressed() const { return _debouncer.pressed(); }
+	uint32_t released() const { return _debouncer.released(); }
+	unsigned long ticks() const { return _ticks; }
+	void beginPass() {
+		unsigned long now = millis();
+		if (now != _lastTick) {
+			_lastTick = now;
+			_ticks++;
+			_debouncer.update(sample());
+		}
+	}
+};
+
+#endif
@@ -58,44 +58,252 @@ struct EncoderConfig {
 	EncoderConfig(int clkPinValue, int dtPinValue) : clockPin(clkPinValue), dataPin(dtPinValue) { }
 };
 
-class EncoderWheel : public EdgeDetectorBase {
-	DigitalRead _clk;
-	DigitalRead _data;
+/*
+QuadratureDecoder turns CLK/DT samples into steps.  The previous and current 2-bit
+states index a 16-entry table that says whether the move was a quarter step forward,
+back, nothing, or impossible (both lines changed at once, so a state was missed).
+Impossible moves are ignored and counted in invalid(); lots of them mean the pins
+aren't being sampled fast enough.
+
+resolution is the number of counts per full quadrature cycle: 1 (one per detent on the
+usual encoders, the default), 2 or 4.  Counts only happen on arriving at a rest state
+(both lines HIGH, and for x2 both LOW as well), so a wheel wobbling on a detent doesn't
+count at all.
+
+update() is a handful of instructions and touches nothing else, so it can be called
+from a pin change interrupt; read position() from the loop, since it holds off
+interrupts while it copies.
+*/
+class QuadratureDecoder {
+	static const int8_t Invalid = 2;
+	uint8_t _state;
+	int8_t _quarters;
+	uint8_t _resolution;
+	bool _started;
+	volatile long _position;
+	volatile uint16_t _invalid;
+	static int8_t transition(uint8_t index) {
+		// Index is (previous << 2) | current, where a state is (clk << 1) | dt.
+		// Forward is 00 -> 10 -> 11 -> 01 -> 00.
+		static const int8_t table[16] = {
+			0, -1, 1, Invalid,
+			1, 0, Invalid, -1,
+			-1, Invalid, 0, 1,
+			Invalid, 1, -1, 0
+		};
+		return table[index];
+	}
+public:
+	QuadratureDecoder(uint8_t resolution = 1) :
+		_state(0), _quarters(0), _resolution(resolution), _started(false), _position(0), _invalid(0) { }
+	// Returns the change in position: -1, 0 or 1.
+	int8_t update(bool clk, bool dt) {
+		uint8_t state = (clk << 1) | dt;
+		if (!_started) {
+			_started = true;
+			_state = state;
+			return 0;
+		}
+		int8_t delta = transition((_state << 2) | state);
+		_state = state;
+		if (delta == Invalid) {
+			_invalid++;
+			return 0;
+		}
+		if (delta == 0) {
+			return 0;
+		}
+		_quarters += delta;
+		bool count;
+		switch (_resolution) {
+		case 4: count = true; break;
+		case 2: count = state == 3 || state == 0; break;
+		default: count = state == 3; break;
+		}
+		if (!count) {
+			return 0;
+		}
+		int8_t step = _quarters > 0 ? 1 : _quarters < 0 ? -1 : 0;
+		_quarters = 0;
+		_position += step;
+		return step;
+	}
+	uint8_t resolution() const { return _resolution; }
+	long position() const {
+		InterruptLock lock;
+		return _position;
+	}
+	uint16_t invalid() const {
+		InterruptLock lock;
+		return _invalid;
+	}
+};
+
+/*
+StepRate estimates how fast the wheel is turning, in steps per second (negative when
+turning back), from the time between steps.  Each step moves the estimate a quarter
+of the way to the new rate, so one quick flick doesn't count as a fast spin.  Once the
+wheel stops it can't be turning faster than one step in the time since the last one,
+so the estimate falls away with that (checked every 8ms, since it takes a divide).
+*/
+class StepRate {
+	static const long MaxRate = 4000;
+	unsigned long _lastStep;
+	unsigned long _lastCheck;
+	long _rate;
+	bool _stepped;
+public:
+	StepRate() : _lastStep(0), _lastCheck(0), _rate(0), _stepped(false) { }
+	void step(int8_t direction, unsigned long now) {
+		unsigned long elapsed = now - _lastStep;
+		long rate = (_stepped && elapsed) ? (long)min(1000000UL / elapsed, (unsigned long)MaxRate) : 0;
+		rate *= direction;
+		long change = rate - _rate;
+		if ((rate < 0) != (_rate < 0) || abs(change) < 4) {
+			_rate = rate;
+		} else {
+			_rate += change / 4;
+		}
+		_lastStep = now;
+		_lastCheck = now;
+		_stepped = true;
+	}
+	void idle(unsigned long now) {
+		if (_rate == 0 || now - _lastCheck < 8000) return;
+		_lastCheck = now;
+		unsigned long elapsed = now - _lastStep;
+		if ((unsigned long)abs(_rate) * elapsed > 1000000UL) {
+			long bound = 1000000UL / elapsed;
+			_rate = _rate < 0 ? -bound : bound;
+		}
+	}
+	long &rate() { return _rate; }
+	long rate() const { return _rate; }
+};
+
+/*
+Acceleration says how much a step counts for at a given rate: 1 at slowRate steps per
+second or below, maxGain at fastRate or above, and in proportion between.  The default
+(maxGain of 1) is no acceleration.
+*/
+struct Acceleration {
+	long slowRate;
+	long fastRate;
+	int maxGain;
+	Acceleration(long slowRateValue = 0, long fastRateValue = 0, int maxGainValue = 1) :
+		slowRate(slowRateValue), fastRate(fastRateValue), maxGain(maxGainValue) { }
+	int gain(long rate) const {
+		rate = abs(rate);
+		if (maxGain <= 1 || rate <= slowRate) return 1;
+		if (rate >= fastRate) return maxGain;
+		return 1 + (maxGain - 1) * (rate - slowRate) / (fastRate - slowRate);
+	}
+};
+
+/*
+EncoderWheelBase feeds the CLK/DT values to a QuadratureDecoder (once a pass, or once
+an edge for InterruptEncoderWheel) and adds
+the steps to value, within +/- limit, scaled by the acceleration for the current
+rate().  The subclasses decide how the pins are read.
+*/
+class EncoderWheelBase : public Scheduled {
+protected:
 	bool _clkValue;
 	bool _dtValue;
 	int &_value;
 	int _limit;
+	QuadratureDecoder _decoder;
+	StepRate _rate;
+	Acceleration _acceleration;
 public:
-	EncoderWheel(Schedule &schedule, const EncoderConfig &config, int &value, int limit = (MAX_INT - 10)) :
-		EncoderWheel(schedule, config.clockPin, config.dataPin, value) { }
-	EncoderWheel(Schedule &schedule, int clockPin, int dataPin, int &value, int limit = (MAX_INT - 10)) : 
-		EdgeDetectorBase(schedule, _clkValue),
-		_clk(schedule, clockPin, _clkValue, INPUT_PULLUP), 
-		_data(schedule, dataPin, _dtValue, INPUT_PULLUP),
-		_value(value), _limit(limit) { }
-	void onRisingEdge() {
-		if (_dtValue != _clkValue) {
-			_value = constrain(_value + 1, -_limit, +_limit);
-		} else {
-			_value = constrain(_value - 1, -_limit, +_limit);
-		}
+	EncoderWheelBase(Schedule &schedule, int &value, int limit, uint8_t resolution) :
+		Scheduled(schedule), _value(value), _limit(limit), _decoder(resolution) { }
+	void poll() {
+		update(micros());
 	}
-	void onFallingEdge() { }
+	void accelerate(const Acceleration &acceleration) { _acceleration = acceleration; }
+	uint16_t invalid() const { return _decoder.invalid(); }
+	// Steps per second, negative when turning back.
+	long rate() const { return _rate.rate(); }
 	void plot(PlotComposite &plot, String name) {
 		PlotBool::addToPlot(plot, name + ".clock", _clkValue);
 		PlotBool::addToPlot(plot, name + ".data", _dtValue);
+		new PlotNum<long>(plot, name + ".rate", _rate.rate());
+	}
+protected:
+	// Feeds the current CLK/DT values to the decoder; time is when they were read.
+	void update(unsigned long time) {
+		int8_t step = _decoder.update(_clkValue, _dtValue);
+		if (step) {
+			_rate.step(step, time);
+			int gain = _acceleration.gain(_rate.rate());
+			_value = constrain(_value + step * gain, -_limit, +_limit);
+		} else if (_rate.rate()) {
+			_rate.idle(time);
+		}
+	}
+};
+
+class EncoderWheel : public EncoderWheelBase {
+	DigitalRead _clk;
+	DigitalRead _data;
+public:
+	EncoderWheel(Schedule &schedule, const EncoderConfig &config, int &value, int limit = (MAX_INT - 10), uint8_t resolution = 1) :
+		EncoderWheel(schedule, config.clockPin, config.dataPin, value, limit, resolution) { }
+	EncoderWheel(Schedule &schedule, int clockPin, int dataPin, int &value, int limit = (MAX_INT - 10), uint8_t resolution = 1) : 
+		EncoderWheelBase(schedule, value, limit, resolution),
+		_clk(schedule, clockPin, _clkValue, INPUT_PULLUP), 
+		_data(schedule, dataPin, _dtValue, INPUT_PULLUP) { }
+};
+
+/*
+InterruptEncoderWheel is an EncoderWheel that catches CLK and DT with interrupts, so
+steps aren't missed while the loop is held up.  Both pins share one event queue, so
+DT is always seen as it was when CLK changed, and each event goes to the decoder as
+it's taken off the queue, all of them in one pass.  overflows() is from the queue.
+*/
+class InterruptEncoderWheel : public EncoderWheelBase {
+	class Inputs : public InterruptInputs {
+		InterruptEncoderWheel &_wheel;
+	public:
+		Inputs(Schedule &schedule, InterruptEncoderWheel &wheel) : InterruptInputs(schedule), _wheel(wheel) { }
+		bool onEvent(const PinEvent &event) {
+			_wheel.update(event.time);
+			return true;
+		}
+	};
+	Inputs _inputs;
+public:
+	InterruptEncoderWheel(Schedule &schedule, const EncoderConfig &config, int &value, int limit = (MAX_INT - 10), uint8_t resolution = 1) :
+		InterruptEncoderWheel(schedule, config.clockPin, config.dataPin, value, limit, resolution) { }
+	InterruptEncoderWheel(Schedule &schedule, int clockPin, int dataPin, int &value, int limit = (MAX_INT - 10), uint8_t resolution = 1) :
+		EncoderWheelBase(schedule, value, limit, resolution), _inputs(schedule, *this) {
+		_inputs.add(clockPin, _clkValue);
+		_inputs.add(dataPin, _dtValue);
 	}
+	uint16_t overflows() const { return _inputs.overflows(); }
 };
 
+/*
+EncoderControl covers maxVal in 2 * sensitivity steps.  Give it an Acceleration to get
+across the range in fewer turns when spinning fast, e.g. Acceleration(5, 40, 6) moves
+up to 6 steps per detent from 5 detents a second, reaching 6 at 40 a second.
+*/
 template <class T>
 class EncoderControl : private EncoderWheel, private Mapper<int, T> {
 	int _encoderValue = 0;
 public:
-	EncoderControl(Schedule &schedule, const EncoderConfig &config, T &value, int sensitivity, T maxVal) :
-		EncoderControl(schedule, config.clockPin, config.dataPin, value, sensitivity, maxVal) { }
-	EncoderControl(Schedule &schedule, int clockPin, int dataPin, T &value, int sensitivity, T maxVal) :
+	EncoderControl(Schedule &schedule, const EncoderConfig &config, T &value, int sensitivity, T maxVal,
+		const Acceleration &acceleration = Acceleration()) :
+		EncoderControl(schedule, config.clockPin, config.dataPin, value, sensitivity, maxVal, acceleration) { }
+	EncoderControl(Schedule &schedule, int clockPin, int dataPin, T &value, int sensitivity, T maxVal,
+		const Acceleration &acceleration = Acceleration()) :
     	EncoderWheel(schedule, clockPin, dataPin, _encoderValue, abs(sensitivity)),
-    	Mapper<int, T>(schedule, _encoderValue, value, -sensitivity, sensitivity, 0, maxVal) { }
+    	Mapper<int, T>(schedule, _encoderValue, value, -sensitivity, sensitivity, 0, maxVal, true) {
+		accelerate(acceleration);
+	}
+	using EncoderWheel::rate;
+	using EncoderWheel::plot;
 };
 
 #endif
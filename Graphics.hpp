@@ -29,36 +29,362 @@ SOFTWARE.
 #include <EdgeDetector.hpp>
 
 /*
-template <class T>
-struct Pos {
-  Pos(T xval = 0, T yval = 0) : x(xval), y(yval) { }
-  Pos<T> &operator = (const Pos<T> &pos) { x = pos.x; y = pos.y; return *this; }
-  T x;
-  T y;
+Rect is a box in screen pixels: x and y are the top left corner, right() and
+bottom() are one past the far edges.  A rect with no width or height is empty, and
+empty rects don't intersect anything.
+*/
+struct Rect {
+  int16_t x;
+  int16_t y;
+  int16_t width;
+  int16_t height;
+  Rect(int16_t xval = 0, int16_t yval = 0, int16_t w = 0, int16_t h = 0) : x(xval), y(yval), width(w), height(h) { }
+  // The box around a circle (or anything else drawn out to radius r from a point).
+  static Rect around(int16_t cx, int16_t cy, int16_t r) { return Rect(cx - r, cy - r, 2 * r + 1, 2 * r + 1); }
+  // Bigger than any screen; what bounds() says when a Drawable doesn't know.
+  static Rect everything() { return Rect(0, 0, MAX_INT, MAX_INT); }
+  int16_t left() const { return x; }
+  int16_t top() const { return y; }
+  int right() const { return (int)x + width; }
+  int bottom() const { return (int)y + height; }
+  long area() const { return empty() ? 0 : (long)width * height; }
+  bool empty() const { return width <= 0 || height <= 0; }
+  bool intersects(const Rect &r) const {
+    return !empty() && !r.empty() && x < r.right() && r.x < right() && y < r.bottom() && r.y < bottom();
+  }
+  // The smallest rect holding both (ignoring either one if it's empty).
+  Rect unite(const Rect &r) const {
+    if (empty()) return r;
+    if (r.empty()) return *this;
+    int16_t x0 = min(x, r.x);
+    int16_t y0 = min(y, r.y);
+    return Rect(x0, y0, max(right(), r.right()) - x0, max(bottom(), r.bottom()) - y0);
+  }
+  // The part of this rect that's inside r.
+  Rect clip(const Rect &r) const {
+    int16_t x0 = max(x, r.x);
+    int16_t y0 = max(y, r.y);
+    int x1 = min(right(), r.right());
+    int y1 = min(bottom(), r.bottom());
+    return x1 > x0 && y1 > y0 ? Rect(x0, y0, x1 - x0, y1 - y0) : Rect();
+  }
+  bool operator == (const Rect &r) const { return x == r.x && y == r.y && width == r.width && height == r.height; }
+  bool operator != (const Rect &r) const { return !(*this == r); }
 };
 
-template <class T>
-struct Size {
-  Size(T w = 0, T h = 0) : width(w), height(h) { }
-  Size<T> &operator = (const Size<T> &size) { width = size.width; height = size.height; return *this; }
-  T width;
-  T height;
-};
+/*
+SpriteImage is a small bitmap laid out the way FrameBuffer and the SSD1306 are: a
+byte is 8 pixels stacked vertically (bit 0 at the top), and each row of bytes is a
+page 8 pixels tall, so an 8x8 sprite is 8 bytes.  Set bits are drawn white.
+
+mask, if there is one, has the same layout and says which pixels the sprite covers:
+those are cleared to black before the image goes on, so a sprite can have a hole
+or a dark outline.  Without a mask only the white pixels are drawn.
+
+Drawing a sprite at a y that isn't a multiple of 8 means shifting each byte across
+two pages.  That's cheap on the host but variable shifts are slow on AVR, so an
+image can instead hold all 8 shifted copies (variants = 8): copy s is the sprite
+moved down s rows, one page taller than the original, one after the other.
+preshift() builds them in RAM; print them out on the host to put them in PROGMEM.
 
-template <class T>
-struct Rect : public Pos<T>, public Size<T> {
-  Rect(T x = 0, T y = 0, T width = 0, T height = 0) : Pos<T>(x, y), Size<T>(width, height) { }
-  Rect<T> &operator = (const Rect<T> &rect) { this->x = rect.x; this->y = rect.y; this->width = rect.width; this->height = rect.height; return *this; }
-  T left() const { return this->x; }
-  T top() const { return this->y; }
-  T right() const { return this->x + this->width; }
-  T bottom() const { return this->y + this->height; }
+The bytes are in PROGMEM unless ram is set.
+Example:
+// A ball, 8x8, solid so it hides what's under it.
+const uint8_t ballImage[] PROGMEM = { 0x3C, 0x7E, 0xFF, 0xFF, 0xFF, 0xFF, 0x7E, 0x3C };
+const SpriteImage ball = { 8, 8, ballImage, ballImage, 1 };
+*/
+struct SpriteImage {
+  uint8_t width;
+  uint8_t height;
+  const uint8_t *image;
+  const uint8_t *mask;
+  uint8_t variants;
+  bool ram;
+  uint8_t pages() const { return (height + 7) >> 3; }
+  // Rows of bytes in each variant.
+  uint8_t rows() const { return variants == 8 ? pages() + 1 : pages(); }
+  uint8_t read(const uint8_t *p) const { return ram ? *p : pgm_read_byte(p); }
+  // Bytes needed for each of the image and mask once pre-shifted.
+  size_t preshiftedSize() const { return 8 * (pages() + 1) * width; }
+  // The byte for row r (counting from the sprite's first page) and column c of the
+  // sprite moved down by shift rows.
+  uint8_t imageByte(uint8_t shift, uint8_t r, uint8_t c) const { return shifted(image, shift, r, c); }
+  uint8_t maskByte(uint8_t shift, uint8_t r, uint8_t c) const { return shifted(mask, shift, r, c); }
+  // All 8 shifted copies, in the caller's buffers (preshiftedSize() bytes each;
+  // mask can be NULL if there isn't one).
+  SpriteImage preshift(uint8_t *imageOut, uint8_t *maskOut) const {
+    uint8_t rowsOut = pages() + 1;
+    for (uint8_t shift = 0; shift < 8; shift++) {
+      for (uint8_t r = 0; r < rowsOut; r++) {
+        for (uint8_t c = 0; c < width; c++) {
+          size_t i = (shift * rowsOut + r) * width + c;
+          imageOut[i] = imageByte(shift, r, c);
+          if (mask != NULL && maskOut != NULL) {
+            maskOut[i] = maskByte(shift, r, c);
+          }
+        }
+      }
+    }
+    SpriteImage result = { width, height, imageOut, mask != NULL ? maskOut : NULL, 8, true };
+    return result;
+  }
+private:
+  uint8_t shifted(const uint8_t *bytes, uint8_t shift, uint8_t r, uint8_t c) const {
+    if (variants == 8) {
+      return read(bytes + (shift * rows() + r) * width + c);
+    }
+    uint8_t b = r < pages() ? read(bytes + r * width + c) << shift : 0;
+    if (shift != 0 && r > 0) {
+      b |= read(bytes + (r - 1) * width + c) >> (8 - shift);
+    }
+    return b;
+  }
 };
+
+/*
+FrameBuffer is a 1 bit per pixel drawing surface laid out like SSD1306 memory: one
+byte is 8 pixels stacked vertically, a row of bytes is a page 8 pixels tall.  It's an
+Adafruit_GFX, so anything that draws on a display can draw on it, but lines, spans
+and fills work a byte at a time instead of a drawPixel() call per pixel (and
+fillCircle() and friends are built on those spans).  Colors are SSD1306_WHITE,
+SSD1306_BLACK and SSD1306_INVERSE.  There's no rotation.
+
+Everything is clipped to clip(), which is the whole buffer unless setClip() says
+otherwise.  The buffer is either its own or someone else's (e.g. the SSD1306's
+getBuffer()).  If there wasn't room for its own, buffer() is NULL and it's 0x0, so
+drawing on it does nothing.
+
+On the host, writePBM() saves it as an image, lit pixels white, so a test can look
+at what was drawn.
+Example:
+FrameBuffer frame(128, 32);
+frame.fillCircle(64, 16, 10, SSD1306_WHITE);
+frame.writePBM("circle.pbm");
 */
+class FrameBuffer : public Adafruit_GFX {
+  uint8_t *_buffer;
+  const bool _owned;
+  Rect _clip;
+public:
+  FrameBuffer(int16_t w, int16_t h) :
+    Adafruit_GFX(w, h), _buffer(new uint8_t[w * ((h + 7) / 8)]), _owned(true), _clip(0, 0, w, h) {
+    if (_buffer == NULL) {
+      _width = 0;
+      _height = 0;
+      _clip = Rect();
+      return;
+    }
+    memset(_buffer, 0, size());
+  }
+  FrameBuffer(int16_t w, int16_t h, uint8_t *buffer) :
+    Adafruit_GFX(w, h), _buffer(buffer), _owned(false), _clip(0, 0, w, h) { }
+  ~FrameBuffer() {
+    if (_owned) {
+      delete [] _buffer;
+    }
+  }
+  // Draw into a different buffer (one that isn't ours), of the given size.
+  void attach(uint8_t *buffer, int16_t w, int16_t h) {
+    if (_owned) {
+      return;
+    }
+    _buffer = buffer;
+    _width = w;
+    _height = h;
+    _clip = Rect(0, 0, w, h);
+  }
+  uint8_t *buffer() { return _buffer; }
+  const uint8_t *buffer() const { return _buffer; }
+  size_t size() const { return width() * ((height() + 7) / 8); }
+  Rect screen() const { return Rect(0, 0, width(), height()); }
+  const Rect &clip() const { return _clip; }
+  void setClip(const Rect &rect) { _clip = rect.clip(screen()); }
+  void clearClip() { _clip = screen(); }
+  bool getPixel(int16_t x, int16_t y) const {
+    if (x < 0 || y < 0 || x >= width() || y >= height()) return false;
+    return (_buffer[x + (y >> 3) * width()] >> (y & 7)) & 1;
+  }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x < _clip.x || y < _clip.y || x >= _clip.right() || y >= _clip.bottom()) return;
+    apply(_buffer[x + (y >> 3) * width()], 1 << (y & 7), color);
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x, y, w, 1, color);
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x, y, 1, h, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    // A negative size draws nothing, the same as the SSD1306 driver.
+    Rect r = Rect(x, y, w, h).clip(_clip);
+    if (r.empty()) {
+      return;
+    }
+    int16_t x0 = r.left();
+    int16_t columns = r.width;
+    int y0 = r.top();
+    int y1 = r.bottom();
+    for (int page = y0 >> 3; page <= (y1 - 1) >> 3; page++) {
+      int top = max(y0, page << 3) - (page << 3);
+      int bottom = min(y1, (page + 1) << 3) - (page << 3);
+      uint8_t mask = (uint8_t)(0xFF << top) & (uint8_t)(0xFF >> (8 - bottom));
+      uint8_t *b = _buffer + page * width() + x0;
+      if (mask == 0xFF && color != SSD1306_INVERSE) {
+        memset(b, color == SSD1306_WHITE ? 0xFF : 0x00, columns);
+      } else {
+        for (int16_t i = 0; i < columns; i++) {
+          apply(b[i], mask, color);
+        }
+      }
+    }
+  }
+  // Straight lines are spans; anything else is Bresenham setting bits directly,
+  // without a drawPixel() call per pixel.
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    if (x0 == x1) {
+      fillRect(x0, min(y0, y1), 1, abs(y1 - y0) + 1, color);
+      return;
+    }
+    if (y0 == y1) {
+      fillRect(min(x0, x1), y0, abs(x1 - x0) + 1, 1, color);
+      return;
+    }
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+    const int16_t left = _clip.x, top = _clip.y, right = _clip.right(), bottom = _clip.bottom();
+    for (;;) {
+      if (x0 >= left && x0 < right && y0 >= top && y0 < bottom) {
+        apply(_buffer[x0 + (y0 >> 3) * width()], 1 << (y0 & 7), color);
+      }
+      if (x0 == x1 && y0 == y1) break;
+      int16_t e2 = 2 * err;
+      if (e2 >= dy) { err += dy; x0 += sx; }
+      if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+  }
+  void fillScreen(uint16_t color) { fillRect(0, 0, width(), height(), color); }
+  void clear() { memset(_buffer, 0, size()); }
+  // Draw a sprite with its top left corner at (x, y), a byte at a time: clear what
+  // the mask covers, then OR the image in.
+  void blit(int16_t x, int16_t y, const SpriteImage &sprite) {
+    int16_t c0 = max(x, _clip.x);
+    int c1 = min((int)x + sprite.width, _clip.right());
+    if (c0 >= c1) {
+      return;
+    }
+    // y >> 3 rounds down (and y & 7 stays positive) for negative y too.
+    int16_t page0 = y >> 3;
+    uint8_t shift = y & 7;
+    uint8_t rows = shift ? sprite.pages() + 1 : sprite.pages();
+    for (uint8_t r = 0; r < rows; r++) {
+      int page = page0 + r;
+      int top = max((int)_clip.y, page << 3) - (page << 3);
+      int bottom = min(_clip.bottom(), (page + 1) << 3) - (page << 3);
+      if (top >= bottom) {
+        continue; // entirely outside the clip
+      }
+      uint8_t keep = (uint8_t)(0xFF << top) & (uint8_t)(0xFF >> (8 - bottom));
+      uint8_t *b = _buffer + page * width();
+      if (sprite.variants == 8) {
+        // Pre-shifted: straight byte copies.
+        size_t row = (shift * sprite.rows() + r) * sprite.width;
+        const uint8_t *image = sprite.image + row;
+        const uint8_t *mask = sprite.mask != NULL ? sprite.mask + row : image;
+        for (int16_t c = c0; c < c1; c++) {
+          uint8_t i = sprite.read(image + c - x) & keep;
+          b[c] = (b[c] & ~(sprite.read(mask + c - x) & keep)) | i;
+        }
+      } else {
+        // Shifted on the fly: the top of source row r and the bottom of row r - 1.
+        const uint8_t *mask = sprite.mask != NULL ? sprite.mask : sprite.image;
+        bool hasLow = r < sprite.pages();
+        bool hasHigh = shift && r > 0;
+        const uint8_t *low = sprite.image + r * sprite.width;
+        const uint8_t *lowMask = mask + r * sprite.width;
+        const uint8_t *high = hasHigh ? low - sprite.width : low;
+        const uint8_t *highMask = hasHigh ? lowMask - sprite.width : lowMask;
+        for (int16_t c = c0; c < c1; c++) {
+          uint8_t i = 0, m = 0;
+          uint8_t column = c - x;
+          if (hasLow) {
+            i = sprite.read(low + column) << shift;
+            m = sprite.read(lowMask + column) << shift;
+          }
+          if (hasHigh) {
+            i |= sprite.read(high + column) >> (8 - shift);
+            m |= sprite.read(highMask + column) >> (8 - shift);
+          }
+          b[c] = (b[c] & ~(m & keep)) | (i & keep);
+        }
+      }
+    }
+  }
+#ifdef ARDUINO_HOST
+  bool writePBM(const char *path) const { return writePBM(path, _buffer, width(), height()); }
+  // Any page-packed buffer, e.g. an Adafruit_SSD1306's frame().
+  static bool writePBM(const char *path, const uint8_t *pages, int16_t w, int16_t h) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+      return false;
+    }
+    fprintf(file, "P4\n%d %d\n", w, h);
+    for (int16_t y = 0; y < h; y++) {
+      uint8_t bits = 0;
+      for (int16_t x = 0; x < w; x++) {
+        // PBM has 1 for black; lit pixels come out white, like the panel.
+        if (!((pages[x + (y >> 3) * w] >> (y & 7)) & 1)) {
+          bits |= 0x80 >> (x & 7);
+        }
+        if ((x & 7) == 7 || x == w - 1) {
+          fputc(bits, file);
+          bits = 0;
+        }
+      }
+    }
+    return fclose(file) == 0;
+  }
+#endif
+private:
+  static void apply(uint8_t &b, uint8_t mask, uint16_t color) {
+    switch (color) {
+    case SSD1306_WHITE: b |= mask; break;
+    case SSD1306_BLACK: b &= ~mask; break;
+    case SSD1306_INVERSE: b ^= mask; break;
+    }
+  }
+};
+
+/*
+Drawables tell the MainWindow where they draw with bounds(), and call invalidate()
+when they'd look different drawn again in the same place (an LED going on, a score
+going up).  The window notices moves by itself, from bounds(), so invalidate() isn't
+strictly needed for those.  Something that watches state it doesn't own can
+override changed() instead, which the window asks once per frame.
+
+The default bounds() is the whole screen, so a Drawable that doesn't say otherwise
+gets a full redraw whenever it invalidates.
 
+draw() may be called any time something near it was damaged, not just when it
+changed, so it has to draw the same pixels each time for the same state.  The window
+clears each damaged rect and redraws everything over it, in order, clipped to that
+rect, so a Drawable that draws black or INVERSE only ever touches pixels that are
+being redrawn anyway.
+*/
 class Drawable {
+  friend class MainWindow;
+  Rect _drawn; // where the window last drew it
+  bool _invalid;
 public:
+  Drawable() : _invalid(true) { }
   virtual void draw(Adafruit_GFX &display) = 0;
+  // How the window draws it.  Override this to use FrameBuffer-only tricks (like
+  // blit()); it's a different name so overriding draw() doesn't hide it.
+  virtual void render(FrameBuffer &frame) { draw(frame); }
+  virtual Rect bounds() const { return Rect::everything(); }
+  virtual bool changed() { return false; }
+  // Have the window redraw this next frame.
+  void invalidate() { _invalid = true; }
 };
 
 class DrawableComposite : public Composite<Drawable> {
@@ -66,45 +392,361 @@ public:
   DrawableComposite(Drawable *itemsZ[] = NULL) :
     Composite<Drawable>(itemsZ, countZ(itemsZ)) { }
   void draw(Adafruit_GFX &display) {
-		for (int i = 0; i < length(); i++) {
-			item(i)->draw(display);
+		for (Iterator i = items(); !i.done(); i.next()) {
+			i.current()->draw(display);
 		}
 	}
 };
 
-class MainWindow : public Clock, private EdgeDetectorBase {
+/*
+DamageList is a few rects of screen that need work, kept separate so two things
+changing at opposite ends of the screen don't turn into one big box.  Rects that
+overlap are merged, and once it's full a new rect merges with whichever grows
+least.
+*/
+class DamageList {
+  static const int Max = 4;
+  Rect _rects[Max];
+  int _count;
+public:
+  DamageList() : _count(0) { }
+  void add(const Rect &rect) {
+    Rect r = rect;
+    if (r.empty()) {
+      return;
+    }
+    // Fold in anything it overlaps; the result may overlap others, so go round again.
+    for (int i = 0; i < _count; ) {
+      if (_rects[i].intersects(r)) {
+        r = r.unite(_rects[i]);
+        _rects[i] = _rects[--_count];
+        i = 0;
+      } else {
+        i++;
+      }
+    }
+    if (_count == Max) {
+      int best = 0;
+      long growth = MAX_LONG;
+      for (int i = 0; i < _count; i++) {
+        long g = _rects[i].unite(r).area() - _rects[i].area();
+        if (g < growth) {
+          growth = g;
+          best = i;
+        }
+      }
+      r = r.unite(_rects[best]);
+      _rects[best] = _rects[--_count];
+      add(r);
+      return;
+    }
+    _rects[_count++] = r;
+  }
+  void add(const DamageList &other) {
+    for (int i = 0; i < other._count; i++) {
+      add(other._rects[i]);
+    }
+  }
+  void clear() { _count = 0; }
+  int count() const { return _count; }
+  bool empty() const { return _count == 0; }
+  const Rect &operator[](int i) const { return _rects[i]; }
+  bool intersects(const Rect &r) const {
+    for (int i = 0; i < _count; i++) {
+      if (_rects[i].intersects(r)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/*
+MainWindow draws the display when something on it changes, at most once per frame
+interval (50ms unless you say otherwise), and only the parts that were damaged.
+Each frame it collects damage from drawables that moved (old and new bounds) or
+were invalidated (their bounds), plus anything passed to damage(), clears just those
+rects, redraws the drawables that overlap them, and sends the panel only the pages
+and columns they cover.  If nothing is dirty the frame is skipped and nothing is
+drawn or sent; rendered() and skipped() count both.  The first frame damages the
+whole screen.
+
+The transfer doesn't happen all at once: it goes out one small I2C transmission
+per pass (setChunkSize() bytes, 16 by default, which is about 0.4ms at 400kHz), so
+encoders and buttons keep being polled while a frame streams out.  flush() sends the
+rest straight away.  With a single buffer, the next frame waits for the stream to
+finish, since drawing would change bytes still being sent.  setDoubleBuffered(true)
+spends another buffer's worth of RAM on a copy for the stream to send from, so the
+next frame can be drawn meanwhile (but only one frame ahead).
+
+Drawing goes through a FrameBuffer over the display's own buffer rather than the
+driver's drawPixel(), so the display mustn't be rotated.  The transfers talk to the
+panel directly over I2C, at 400kHz like the driver does, so the display has to be on
+a TwoWire (pass it and the address if it isn't Wire at 0x3C).
+Example:
+Adafruit_SSD1306 display(128, 32, &Wire, -1);
+MainWindow window(schedule, display, 40); // no more than 25 frames a second
+VirtualLED led(window, ledState, x, y, radius);
+*/
+class MainWindow : private ScheduledTimer, private Scheduled, public Enabled {
+  // The driver's bus speeds: fast while talking to the panel, normal otherwise.
+  static const unsigned long WireClock = 400000UL;
+  static const unsigned long RestoreClock = 100000UL;
+  // Wire's buffer is 32 bytes, one of which is the control byte.
+  static const uint8_t MaxChunk = 31;
   Adafruit_SSD1306 &_display;
-  long _clockHigh = 25;
-  long _clockLow = 25;
-  bool _clockValue;
+  FrameBuffer _frame; // draws straight into the display's buffer
+  TwoWire &_wire;
+  const uint8_t _address;
+  long _frameInterval;
+  bool _enabled = true;
   List<Drawable*> _items;
+  DamageList _damage;  // to be drawn
+  DamageList _pending; // drawn, waiting to be sent
+  DamageList _sending; // going out now
+  int _sendRect;
+  bool _windowSet;
+  uint8_t _sendPage;
+  uint8_t _sendColumn;
+  uint8_t _chunk;
+  uint8_t *_front; // what's being sent, when double buffered
+  bool _started;
+  unsigned long _transferred;
+  unsigned long _rendered;
+  unsigned long _skipped;
 public:
-  MainWindow(Schedule &schedule, Adafruit_SSD1306 &display) :
-    Clock(schedule, _clockLow, _clockHigh, _clockValue),
-    EdgeDetectorBase(schedule, _clockValue), _display(display) { }
-  void add(Drawable *item) { _items.add(item); }
+  MainWindow(Schedule &schedule, Adafruit_SSD1306 &display, long frameInterval = 50, TwoWire &wire = Wire, uint8_t address = 0x3C) :
+    ScheduledTimer(schedule, frameInterval), Scheduled(schedule), _display(display),
+    _frame(display.width(), display.height(), NULL), _wire(wire), _address(address),
+    _frameInterval(frameInterval), _sendRect(0), _windowSet(false), _sendPage(0), _sendColumn(0), _chunk(16),
+    _front(NULL), _started(false), _transferred(0), _rendered(0), _skipped(0) { }
+  ~MainWindow() { delete [] _front; }
+  void add(Drawable *item) {
+    item->_invalid = true;
+    _items.add(item);
+  }
+  void remove(Drawable *item) {
+    damage(item->_drawn);
+    _items.remove(item);
+  }
+  void enable(bool value) {
+    if (_enabled != value) {
+      _enabled = value;
+      if (_enabled) {
+        reset(0);
+      } else {
+        ScheduledTimer::cancel();
+      }
+    }
+  }
+  void toggle() { enable(!_enabled); }
+  void setFrameInterval(long frameInterval) { _frameInterval = frameInterval; }
+  long frameInterval() const { return _frameInterval; }
+  void setChunkSize(uint8_t bytes) { _chunk = constrain(bytes, 1, MaxChunk); }
+  // Returns false if there wasn't the memory for a second buffer.
+  bool setDoubleBuffered(bool value) {
+    if (value == (_front != NULL)) {
+      return true;
+    }
+    flush();
+    if (value) {
+      _front = new uint8_t[_frame.size()];
+      return _front != NULL;
+    }
+    delete [] _front;
+    _front = NULL;
+    return true;
+  }
+  bool doubleBuffered() const { return _front != NULL; }
+  // Mark part of the screen to be cleared and redrawn next frame.
+  void damage(const Rect &rect) { _damage.add(rect.clip(screen())); }
+  void invalidateAll() { damage(screen()); }
+  Rect screen() const { return Rect(0, 0, _display.width(), _display.height()); }
+  // Bytes sent to the panel so far, for comparing strategies.
+  unsigned long transferred() const { return _transferred; }
+  unsigned long rendered() const { return _rendered; }
+  unsigned long skipped() const { return _skipped; }
+  // True while a frame is still going out to the panel.
+  bool flushing() const { return !_sending.empty() || !_pending.empty(); }
+  // Draw whatever is dirty now, without waiting for the next frame.  Sending it
+  // starts straight away and carries on over the next passes.
   void update() {
-    _display.clearDisplay();
-		for (int i = 0; i < _items.length(); i++) {
-			_items[i]->draw(_display);
-		}
-    _display.display();
+    if (!_started) {
+      // The driver allocates its buffer in begin(), so it's only there now.
+      _frame.attach(_display.getBuffer(), _display.width(), _display.height());
+      // Whatever begin() left in the buffer (the splash screen) has to go.
+      _started = true;
+      invalidateAll();
+    }
+    for (List<Drawable*>::Iterator i = _items.items(); !i.done(); i.next()) {
+      Drawable *item = i.current();
+      Rect bounds = item->bounds();
+      if (item->_invalid || bounds != item->_drawn || item->changed()) {
+        damage(item->_drawn);
+        damage(bounds);
+        item->_invalid = false;
+      }
+    }
+    if (_damage.empty()) {
+      _skipped++;
+      return;
+    }
+    if (!canDraw()) {
+      // Keep the damage for when the panel has caught up.
+      return;
+    }
+    _rendered++;
+    // Each rect is redrawn on its own, clipped, so nothing drawn for it can reach
+    // pixels outside it that belong to items that aren't being redrawn.
+    for (int d = 0; d < _damage.count(); d++) {
+      const Rect &rect = _damage[d];
+      _frame.setClip(rect);
+      _frame.fillRect(rect.x, rect.y, rect.width, rect.height, SSD1306_BLACK);
+      for (List<Drawable*>::Iterator i = _items.items(); !i.done(); i.next()) {
+        Drawable *item = i.current();
+        Rect bounds = item->bounds();
+        if (rect.intersects(bounds)) {
+          item->render(_frame);
+          item->_drawn = bounds;
+        }
+      }
+    }
+    _frame.clearClip();
+    _pending.add(_damage);
+    _damage.clear();
+    if (_sending.empty()) {
+      startSending();
+    }
+  }
+  // Send everything that's been drawn, now.
+  void flush() {
+    while (flushing()) {
+      sendChunk();
+    }
+  }
+private:
+  void onExpired() {
+    if (_enabled) {
+      // If the panel is still busy, check back sooner than a whole frame interval.
+      reset(canDraw() ? _frameInterval : 1);
+      update();
+    }
+  }
+  void poll() {
+    if (flushing()) {
+      sendChunk();
+    }
+  }
+  // With one buffer, drawing has to wait until the last frame is out.  With two it
+  // can get one frame ahead.
+  bool canDraw() const { return _sending.empty() || (_front != NULL && _pending.empty()); }
+  // Hand what's been drawn over to be sent, copying it aside if double buffered.
+  void startSending() {
+    if (_front != NULL) {
+      const uint8_t *back = _frame.buffer();
+      int16_t width = _frame.width();
+      for (int d = 0; d < _pending.count(); d++) {
+        const Rect &r = _pending[d];
+        for (int page = r.top() >> 3; page <= (r.bottom() - 1) >> 3; page++) {
+          memcpy(_front + page * width + r.left(), back + page * width + r.left(), r.width);
+        }
+      }
+    }
+    _sending = _pending;
+    _pending.clear();
+    _sendRect = 0;
+    _windowSet = false;
+  }
+  // One transmission: either the address window for the next rect, or up to _chunk
+  // bytes of it.  The panel is in horizontal addressing mode (begin() sets that), so
+  // after setting the window the data just streams in, wrapping at the edges.
+  void sendChunk() {
+    if (_sending.empty()) {
+      startSending();
+    }
+    const Rect &r = _sending[_sendRect];
+    uint8_t lastPage = (r.bottom() - 1) >> 3;
+    uint8_t lastColumn = r.right() - 1;
+    _wire.setClock(WireClock);
+    _wire.beginTransmission(_address);
+    if (!_windowSet) {
+      _sendPage = r.top() >> 3;
+      _sendColumn = r.left();
+      _wire.write((uint8_t)0x00);
+      _wire.write((uint8_t)SSD1306_PAGEADDR);
+      _wire.write(_sendPage);
+      _wire.write(lastPage);
+      _wire.write((uint8_t)SSD1306_COLUMNADDR);
+      _wire.write(_sendColumn);
+      _wire.write(lastColumn);
+      _wire.endTransmission();
+      _wire.setClock(RestoreClock);
+      _transferred += 7;
+      _windowSet = true;
+      return;
+    }
+    const uint8_t *buffer = _front != NULL ? _front : _frame.buffer();
+    int16_t width = _frame.width();
+    _wire.write((uint8_t)0x40);
+    uint8_t sent = 0;
+    while (sent < _chunk && _sendPage <= lastPage) {
+      _wire.write(buffer[_sendPage * width + _sendColumn]);
+      sent++;
+      if (_sendColumn++ == lastColumn) {
+        _sendColumn = r.left();
+        _sendPage++;
+      }
+    }
+    _wire.endTransmission();
+    _wire.setClock(RestoreClock);
+    _transferred += sent + 1;
+    if (_sendPage > lastPage) {
+      _windowSet = false;
+      if (++_sendRect == _sending.count()) {
+        _sending.clear();
+      }
+    }
   }
-  void onRisingEdge() { update(); }
-  void onFallingEdge() { /* Serial.println("MAINWINDOW FALLING EDGE"); */ }
 };
 
 /*
-class Bitmap : private Drawn {
-  Rect &_rect;
-  const uint8_t *_image;
-  uint16_t _color;
+Sprite is a SpriteImage at a position on the window.  Move it with moveTo() (the
+window notices), and change the picture with setImage().  The window draws it with
+FrameBuffer::blit(); drawn anywhere else it goes a pixel at a time.
+Example:
+Sprite sprite(window, ball, 60, 12);
+void onTick() { sprite.moveTo(sprite.x() + 1, sprite.y()); }
+*/
+class Sprite : public Drawable {
+  const SpriteImage *_image;
+  int16_t _x;
+  int16_t _y;
 public:
-  Bitmap(Adafruit_GFX &display, const uint8_t *image, Rect &rect, uint16_t color = SSD1306_WHITE) :
-    Drawn(display), _rect(rect), _image(image), _color(color) { }
-  void draw() { _display.drawBitmap(_rect.x, _rect.y, _image, _rect.width, _rect.height, _color); }
+  Sprite(MainWindow &window, const SpriteImage &image, int16_t x = 0, int16_t y = 0) :
+    _image(&image), _x(x), _y(y) { window.add(this); }
+  void moveTo(int16_t x, int16_t y) { _x = x; _y = y; }
+  void setImage(const SpriteImage &image) {
+    _image = &image;
+    invalidate();
+  }
+  int16_t x() const { return _x; }
+  int16_t y() const { return _y; }
+  Rect bounds() const { return Rect(_x, _y, _image->width, _image->height); }
+  void render(FrameBuffer &frame) { frame.blit(_x, _y, *_image); }
+  void draw(Adafruit_GFX &display) {
+    for (uint8_t r = 0; r < _image->pages(); r++) {
+      for (uint8_t c = 0; c < _image->width; c++) {
+        uint8_t image = _image->imageByte(0, r, c);
+        uint8_t mask = _image->mask != NULL ? _image->maskByte(0, r, c) : image;
+        for (uint8_t bit = 0; bit < 8 && (r << 3) + bit < _image->height; bit++) {
+          if (mask & (1 << bit)) {
+            display.drawPixel(_x + c, _y + (r << 3) + bit, image & (1 << bit) ? SSD1306_WHITE : SSD1306_BLACK);
+          }
+        }
+      }
+    }
+  }
 };
-*/
 
 class VirtualLED : public Drawable {
   int16_t &_x;
@@ -112,10 +754,16 @@ class VirtualLED : public Drawable {
   const int16_t &_radius;
   const uint16_t _color;
   bool &_ledState;
+  bool _drawnState;
 public:
+  // The LED's state belongs to whatever drives it, so it can't invalidate() when that
+  // changes; it watches through changed() instead.
   VirtualLED(MainWindow &window, bool &ledState, int16_t &x, int16_t &y, int16_t &radius, uint16_t color = SSD1306_WHITE) :
-    _ledState(ledState), _x(x), _y(y), _radius(radius), _color(color) { window.add(this); }
+    _ledState(ledState), _x(x), _y(y), _radius(radius), _color(color), _drawnState(ledState) { window.add(this); }
+  Rect bounds() const { return Rect::around(_x, _y, _radius); }
+  bool changed() { return _ledState != _drawnState; }
   void draw(Adafruit_GFX &display) {
+    _drawnState = _ledState;
     if (_ledState) {
       display.fillCircle(_x, _y, _radius, _color);
     } else {
@@ -125,61 +773,225 @@ public:
 };
 
 /*
-class Label : public Drawable {
-  Pos &_pos;
-  String _text;
-  uint8_t _textSize;
-  uint16_t _fgColor;
-  uint16_t _bgColor;
+Widget is a Drawable that keeps a picture of itself.  paint() draws it (with its
+top left corner at the given point) only when refresh() says the look has changed;
+every other time the window needs it, say because something moved over it, the
+cached picture is blitted back.  So text is laid out and rasterized once per change,
+not once per frame.  The picture is a FrameBuffer of the widget's size, allocated
+when it's first drawn or changes size.  If there isn't room for it, the widget
+is painted straight into the frame every time instead.
+
+Subclasses call resize() and refresh(); both let the window know.  refresh() can be
+given just the part of the widget that changed, so only that is sent to the panel.
+*/
+class Widget : public Drawable {
+  MainWindow &_window;
+  FrameBuffer *_cache;
+  int16_t _x;
+  int16_t _y;
+  uint8_t _width;
+  uint8_t _height;
+  bool _stale;
 public:
-  Label(Adafruit_GFX &display, Pos &pos, const String text = "", uint8_t textSize = 1, uint16_t fgColor = SSD1306_WHITE, uint16_t bgColor = SSD1306_WHITE) :
-    Drawable(display), _textSize(textSize), _fgColor(fgColor), _bgColor(bgColor), _text(text), _pos(pos) { }
-  void setTextSize(uint8_t textSize) { _textSize = textSize; }
-  void setTextColor(uint16_t fg, uint16_t bg) { _fgColor = fg; _bgColor = bg; }
-  void draw() {
-    _display.setTextSize(_textSize);
-    _display.setTextColor(_fgColor, _bgColor);
-    _display.setCursor(_pos.x, _pos.y);
-    _display.print(_text);
-  }
-  void setText(const String &text) { _text = text; }
+  Widget(MainWindow &window, int16_t x, int16_t y, uint8_t width = 0, uint8_t height = 0) :
+    _window(window), _cache(NULL), _x(x), _y(y), _width(width), _height(height), _stale(true) {
+    window.add(this);
+  }
+  ~Widget() { delete _cache; }
+  void moveTo(int16_t x, int16_t y) { _x = x; _y = y; }
+  int16_t x() const { return _x; }
+  int16_t y() const { return _y; }
+  Rect bounds() const { return Rect(_x, _y, _width, _height); }
+  void render(FrameBuffer &frame) {
+    if (_width == 0 || _height == 0) {
+      return;
+    }
+    if (_stale) {
+      if (_cache == NULL || _cache->width() != _width || _cache->height() != _height) {
+        delete _cache;
+        _cache = new FrameBuffer(_width, _height);
+        if (_cache != NULL && _cache->buffer() == NULL) {
+          delete _cache;
+          _cache = NULL;
+        }
+        if (_cache == NULL) {
+          // No room for the cache, so paint straight into the frame instead.
+          paint(frame, _x, _y);
+          return;
+        }
+      } else {
+        _cache->clear();
+      }
+      paint(*_cache, 0, 0);
+      _stale = false;
+    }
+    SpriteImage image = { _width, _height, _cache->buffer(), NULL, 1, true };
+    frame.blit(_x, _y, image);
+  }
+  void draw(Adafruit_GFX &display) { paint(display, _x, _y); }
+protected:
+  virtual void paint(Adafruit_GFX &gfx, int16_t x, int16_t y) = 0;
+  void refresh() {
+    _stale = true;
+    invalidate();
+  }
+  // Only part changed; rect is relative to the widget's top left corner.
+  void refresh(const Rect &rect) {
+    _stale = true;
+    _window.damage(Rect(_x + rect.x, _y + rect.y, rect.width, rect.height));
+  }
+  void resize(uint8_t width, uint8_t height) {
+    if (width != _width || height != _height) {
+      _width = width;
+      _height = height;
+      refresh();
+    }
+  }
 };
 
-class DigitalClockFace : public Label, private Clock, private EdgeDetectorBase {
-  bool _clkValue;
-  long _halfSecond = 500;
+/*
+Label is a line of text (up to MaxText characters) in the default 6x8 font, scaled
+by textSize.  Setting the same text again costs a strcmp(); only a change repaints,
+and if the length is the same only the characters that changed are damaged.
+Example:
+Label score(window, 32, 0, "0");
+void onScore() { score.setNumber(points); }
+*/
+class Label : public Widget {
+public:
+  static const int MaxText = 20;
+private:
+  char _text[MaxText + 1];
+  uint8_t _textSize;
 public:
-  DigitalClockFace(Schedule &schedule, Adafruit_GFX &display, Pos &pos, uint8_t textSize = 4) :
-    Label(display, pos, "12:00", textSize, SSD1306_WHITE, SSD1306_WHITE),
-    Clock(schedule, _halfSecond, _halfSecond, _clkValue),
-    EdgeDetectorBase(schedule, _clkValue) { }
-    void onFallingEdge() { }
-    void onRisingEdge() { updateTime(); }
-    // void updateTime() { setText(String(millis())); }
-    void updateTime() { setText("12:01") ;}
+  Label(MainWindow &window, int16_t x, int16_t y, const char *text = "", uint8_t textSize = 1) :
+    Widget(window, x, y), _textSize(textSize) {
+    _text[0] = 0;
+    setText(text);
+  }
+  const char *text() const { return _text; }
+  void setText(const char *text) {
+    if (strncmp(_text, text, MaxText) == 0) {
+      return;
+    }
+    size_t length = strlen(_text);
+    if (strlen(text) == length) {
+      size_t first = 0;
+      while (_text[first] == text[first]) first++;
+      size_t last = length - 1;
+      while (_text[last] == text[last]) last--;
+      memcpy(_text + first, text + first, last - first + 1);
+      refresh(Rect(first * 6 * _textSize, 0, (last - first + 1) * 6 * _textSize, 8 * _textSize));
+      return;
+    }
+    strncpy(_text, text, MaxText);
+    _text[MaxText] = 0;
+    fit();
+    refresh();
+  }
+  void setNumber(long value) {
+    // Built backwards from the last digit.
+    char buffer[12];
+    char *p = buffer + sizeof(buffer) - 1;
+    *p = 0;
+    unsigned long n = value < 0 ? -(unsigned long)value : value;
+    do {
+      *--p = '0' + n % 10;
+      n /= 10;
+    } while (n);
+    if (value < 0) {
+      *--p = '-';
+    }
+    setText(p);
+  }
+  void setTextSize(uint8_t textSize) {
+    if (textSize != _textSize) {
+      _textSize = textSize;
+      fit();
+    }
+  }
+protected:
+  void paint(Adafruit_GFX &gfx, int16_t x, int16_t y) {
+    gfx.setTextSize(_textSize);
+    gfx.setTextColor(SSD1306_WHITE);
+    gfx.setCursor(x, y);
+    gfx.print(_text);
+  }
+private:
+  void fit() { resize(min(255, (int)strlen(_text) * 6 * _textSize), min(255, 8 * _textSize)); }
 };
 
-// Maybe leverage some of their code?
-// Not sure how you emit/change the state.
-class GFXButton : public Drawable, private Adafruit_GFX_Button, private Scheduled {
-  EdgeDetector _detector;
-  char _buffer[32];
-  bool _btnState;
+/*
+DigitalClockFace shows the time as HH:MM, with the colon blinking once a second.
+There's no real-time clock behind it, just millis() from whenever set() was called.
+The text changes once a second, so the window has one small repaint a second and
+nothing at all in between.
+Example:
+DigitalClockFace face(schedule, window, 4, 0);
+void setup() { face.set(12, 0); }
+*/
+class DigitalClockFace : public Label, private ScheduledTimer {
+  unsigned long _start; // seconds since midnight when millis() was 0
 public:
-  GFXButton(Schedule &schedule, Adafruit_GFX &display, const Rect &rect, const char *text, void (*onButtonPressed)()) :
-    Drawable(display),
-    Scheduled(schedule), _detector(schedule, _btnState, onButtonPressed) {
-    strcpy(_buffer, text);
-    initButtonUL(&display, rect.x, rect.y, rect.width, rect.height, SSD1306_WHITE, SSD1306_WHITE, SSD1306_WHITE, _buffer, 1);
+  DigitalClockFace(Schedule &schedule, MainWindow &window, int16_t x, int16_t y, uint8_t textSize = 4) :
+    Label(window, x, y, "12:00", textSize), ScheduledTimer(schedule, 0), _start(12UL * 3600) { }
+  void set(uint8_t hours, uint8_t minutes, uint8_t seconds = 0) {
+    _start = (hours * 3600UL + minutes * 60UL + seconds) + 86400UL - (millis() / 1000) % 86400UL;
+    reset(0);
   }
-  void draw() {
-    drawButton();
+  void onExpired() {
+    unsigned long now = millis();
+    unsigned long seconds = (_start + now / 1000) % 86400UL;
+    uint8_t hours = seconds / 3600;
+    uint8_t minutes = (seconds / 60) % 60;
+    char text[6] = {
+      (char)('0' + hours / 10), (char)('0' + hours % 10),
+      (char)(seconds & 1 ? ' ' : ':'),
+      (char)('0' + minutes / 10), (char)('0' + minutes % 10), 0
+    };
+    setText(text);
+    // Wake again at the top of the next second.
+    reset(999 - now % 1000);
+  }
+};
+
+/*
+GFXButton draws an Adafruit_GFX_Button (outline and centered label) that shows
+pressed, inverted, while pressed is true.  That's whatever input drives it, e.g. a
+ButtonValue; onPressed() is called as it goes down.
+Example:
+bool okDown;
+GFXButton ok(schedule, window, Rect(80, 40, 40, 20), "OK", okDown, &onOk);
+*/
+class GFXButton : public Widget, private Scheduled, private Adafruit_GFX_Button {
+  char _label[10];
+  bool &_pressed;
+  bool _shown;
+  void (*_onPressed)();
+public:
+  GFXButton(Schedule &schedule, MainWindow &window, const Rect &rect, const char *label, bool &pressed,
+    void (*onPressed)() = NULL) :
+    Widget(window, rect.x, rect.y, rect.width, rect.height), Scheduled(schedule),
+    _pressed(pressed), _shown(pressed), _onPressed(onPressed) {
+    strncpy(_label, label, sizeof(_label) - 1);
+    _label[sizeof(_label) - 1] = 0;
   }
   void poll() {
-    _btnState = isPressed();
+    if (_pressed != _shown) {
+      _shown = _pressed;
+      refresh();
+      if (_shown && _onPressed) {
+        _onPressed();
+      }
+    }
+  }
+protected:
+  void paint(Adafruit_GFX &gfx, int16_t x, int16_t y) {
+    Rect box = bounds();
+    initButtonUL(&gfx, x, y, box.width, box.height, SSD1306_WHITE, SSD1306_BLACK, SSD1306_WHITE, _label, 1);
+    drawButton(_shown);
   }
 };
-*/
 
 /*
 class Turtle : public Drawable {
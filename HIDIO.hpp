@@ -132,29 +132,36 @@ public:
 		ValuePresser(schedule, _value, button) { }
 };
 
-/* It's assumed that the delay is much shorter than the press/release times. */
-class PressFollower : private Scheduled, public Pressable {
-	Timer _pressTimer;
-	Timer _releaseTimer;
-	const long _delay;
+/**
+ * DelayedPress calls press() (or release()) on its output once start()'s delay runs out.
+*/
+class DelayedPress : private ScheduledTimer {
 	Pressable &_output;
+	const bool _press;
 public:
-	PressFollower(Schedule &schedule, long delayValue, Pressable &output) :
-		Scheduled(schedule),
-		_pressTimer(MAX_LONG), _releaseTimer(MAX_LONG),
-		_delay(delayValue), _output(output) { }
-	void poll() {
-		if (_pressTimer.expired()) {
+	DelayedPress(Schedule &schedule, Pressable &output, bool press) :
+		ScheduledTimer(schedule, MAX_LONG), _output(output), _press(press) { }
+	void start(long delayValue) { reset(delayValue); }
+	void onExpired() {
+		if (_press) {
 			_output.press();
-			_pressTimer.reset(MAX_LONG);
-		}
-		if (_releaseTimer.expired()) {
+		} else {
 			_output.release();
-			_releaseTimer.reset(MAX_LONG);
 		}
 	}
-	void press() { _pressTimer.reset(_delay); }
-	void release() { _releaseTimer.reset(_delay); }
+};
+
+/* It's assumed that the delay is much shorter than the press/release times. */
+class PressFollower : public Pressable {
+	DelayedPress _pressTimer;
+	DelayedPress _releaseTimer;
+	const long _delay;
+public:
+	PressFollower(Schedule &schedule, long delayValue, Pressable &output) :
+		_pressTimer(schedule, output, true), _releaseTimer(schedule, output, false),
+		_delay(delayValue) { }
+	void press() { _pressTimer.start(_delay); }
+	void release() { _releaseTimer.start(_delay); }
 };
 
 #endif
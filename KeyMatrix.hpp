@@ -0,0 +1,141 @@
+/*
+MIT License
+
+Copyright (c) 2022 jffordem
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef KEYMATRIX_HPP
+#define KEYMATRIX_HPP
+
+#include <Scheduler.hpp>
+#include <PinIO.hpp>
+#include <Debouncer.hpp>
+
+/*
+KeyMatrix scans a grid of keys wired across Rows row pins and Cols column pins (up
+to 16), so 64 keys only take 16 pins.  Columns are inputs with pullups; one row at a
+time is driven LOW and the keys pressed in it pull their columns LOW.
+
+It scans one row per pass and never waits: the row for the next pass is driven at the
+end of this one, so it has settled by the time the columns are read.  A full scan
+takes Rows passes, e.g. an 8x8 pad scans at 1kHz once the loop does 8000 passes a
+second.  Each key is debounced over debounceScans scans (1 to 4).
+
+Without a diode per key, three keys pressed on the corners of a rectangle make the
+fourth look pressed too.  When a row shares two or more pressed columns with another
+row, new presses in it are ignored until that clears up, and ghosts() counts it.
+
+The debounced state is kept as a bitmap, one word per row (row(r), pressed(r, c)),
+and each press or release goes to the key's Pressable, if it has one.
+
+Example:
+const uint8_t rowPins[4] = { 2, 3, 4, 5 };
+const uint8_t colPins[4] = { 6, 7, 8, 9 };
+KeyPress f1(KEY_F1), f2(KEY_F2);
+Pressable *keys[16] = { &f1, &f2 };   // row-major; the rest do nothing
+KeyMatrix<4, 4> pad(schedule, rowPins, colPins, keys);
+*/
+template <int Rows, int Cols>
+class KeyMatrix : public Scheduled {
+	static_assert(Rows > 0 && Cols > 0 && Cols <= 16, "KeyMatrix takes up to 16 columns");
+	uint8_t _rowPins[Rows];
+	PinIn _cols[Cols];
+	Pressable *_targets[Rows * Cols];
+	uint16_t _raw[Rows];
+	Debouncer<uint16_t, 2> _debouncers[Rows];
+	int _row;
+	unsigned long _scans;
+	unsigned long _ghosts;
+	void drive(int row) {
+		pinMode(_rowPins[row], OUTPUT);
+	}
+	void release(int row) {
+		pinMode(_rowPins[row], INPUT);
+	}
+	bool ghosted(int row, uint16_t raw) const {
+		for (int r = 0; r < Rows; r++) {
+			uint16_t shared = raw & _raw[r];
+			// Two or more bits in common.
+			if (r != row && (shared & (shared - 1))) {
+				return true;
+			}
+		}
+		return false;
+	}
+public:
+	KeyMatrix(Schedule &schedule, const uint8_t (&rowPins)[Rows], const uint8_t (&colPins)[Cols],
+		Pressable *targets[] = NULL, int debounceScans = 2) :
+		Scheduled(schedule), _row(0), _scans(0), _ghosts(0) {
+		for (int r = 0; r < Rows; r++) {
+			_rowPins[r] = rowPins[r];
+			// LOW in the output register, so switching it to OUTPUT drives it LOW.
+			digitalWrite(_rowPins[r], LOW);
+			release(r);
+			_raw[r] = 0;
+			for (int c = 0; c < Cols; c++) {
+				_debouncers[r].setTicks(c, debounceScans);
+			}
+		}
+		for (int c = 0; c < Cols; c++) {
+			_cols[c].attach(schedule, colPins[c], INPUT_PULLUP);
+		}
+		for (int i = 0; i < Rows * Cols; i++) {
+			_targets[i] = targets ? targets[i] : NULL;
+		}
+		drive(_row);
+	}
+	void setTarget(int row, int col, Pressable *target) { _targets[row * Cols + col] = target; }
+	void poll() {
+		uint16_t raw = 0;
+		for (int c = 0; c < Cols; c++) {
+			if (!_cols[c].read()) {
+				raw |= (uint16_t)1 << c;
+			}
+		}
+		Debouncer<uint16_t, 2> &debouncer = _debouncers[_row];
+		_raw[_row] = raw;
+		if (ghosted(_row, raw)) {
+			_ghosts++;
+			// Let keys go, but don't believe any new ones.
+			raw &= debouncer.state();
+		}
+		if (debouncer.update(raw)) {
+			Pressable **targets = _targets + _row * Cols;
+			for (int c = 0; c < Cols; c++) {
+				if (!targets[c]) continue;
+				if ((debouncer.pressed() >> c) & 1) targets[c]->press();
+				if ((debouncer.released() >> c) & 1) targets[c]->release();
+			}
+		}
+		release(_row);
+		if (++_row == Rows) {
+			_row = 0;
+			_scans++;
+		}
+		drive(_row);
+	}
+	uint16_t row(int r) const { return _debouncers[r].state(); }
+	bool pressed(int r, int c) const { return (row(r) >> c) & 1; }
+	unsigned long scans() const { return _scans; }
+	unsigned long ghosts() const { return _ghosts; }
+};
+
+#endif
@@ -57,16 +57,15 @@ public:
 // Pins a - g are top, ur, lr, bot, ll, ul, mid
 class SevenSegLED : public Scheduled {
 	static const int num_pins = 7;
-	const int *_pins;
+	PinOut _pins[num_pins];
 	const bool _lowIsOn;
 	short &_value;
 public:
 	SevenSegLED(Schedule &schedule, int *pins, short &value, bool lowIsOn = true) :
-		Scheduled(schedule), _pins(pins), _lowIsOn(lowIsOn), _value(value) {
-		for (int i = 0; i < num_pins; i++) {
-			pinMode(_pins[i], OUTPUT);
-		}
-	}
+		Scheduled(schedule),
+		_pins{ { schedule, pins[0] }, { schedule, pins[1] }, { schedule, pins[2] }, { schedule, pins[3] },
+			{ schedule, pins[4] }, { schedule, pins[5] }, { schedule, pins[6] } },
+		_lowIsOn(lowIsOn), _value(value) { }
 	void poll() {
 		int current = _value;
 		static const int digits[10][num_pins] = {
@@ -82,7 +81,7 @@ public:
 			{1, 1, 1, 0, 0, 1, 1}  // 9
 		};
 		for (int i = 0; i < num_pins; i++) {
-			digitalWrite(_pins[i], getPinValue(digits[current][i]));
+			_pins[i].write(getPinValue(digits[current][i]));
 		}
 	}
 private:
@@ -36,14 +36,14 @@ Pins: 3, 5, 6, 9, 10, 11, 13.
 */
 
 struct {
-  const LedConfig DefaultLed = { .pin = LED_BUILTIN, .lowIsOn = false };
+  const LedConfig DefaultLed = { /* pin */ LED_BUILTIN, /* lowIsOn */ false };
   struct {
-    const ButtonConfig Button = { .pin = 5, .lowIsPressed = true };
-    const EncoderConfig Encoder = { .clockPin = 7, .dataPin = 6 };
+    const ButtonConfig Button = { /* pin */ 5, /* lowIsPressed */ true };
+    const EncoderConfig Encoder = { /* clockPin */ 7, /* dataPin */ 6 };
   } Left;
   struct {
-    const ButtonConfig Button = { .pin = 8, .lowIsPressed = true };
-    const EncoderConfig Encoder = { .clockPin = 10, .dataPin = 9 };
+    const ButtonConfig Button = { /* pin */ 8, /* lowIsPressed */ true };
+    const EncoderConfig Encoder = { /* clockPin */ 10, /* dataPin */ 9 };
   } Right;
 } Config;
 
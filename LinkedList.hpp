@@ -37,14 +37,16 @@ template <class T>
 class IList {
 public:
     virtual void add(T item) = 0;
+    virtual void clear() = 0;
+    virtual void remove(T item) = 0;
+    virtual bool contains(T item) const = 0;
     virtual int length() const = 0;
     virtual T item(int index) const = 0;
     virtual T operator[](int index) const { return item(index); }
+    // True if an add() was dropped because the list was full.
+    virtual bool overflowed() const { return false; }
 };
 
-#define USE_LINKED_LIST
-#ifdef USE_LINKED_LIST
-
 template <class T, class U>
 class Pair {
 	T _car;
@@ -61,11 +63,31 @@ public:
 	ListPair(T head, ListPair<T> *tail) : Pair<T, ListPair<T>*>(head, tail) { }
 };
 
+/*
+ListIterator walks the list once from the head, so a loop over all of the items
+is a single linear sweep instead of calling item(i) (which starts over every time).
+Example:
+for (List<Poller*>::Iterator i = pollers.items(); !i.done(); i.next()) {
+    i.current()->poll();
+}
+*/
+template <class T>
+class ListIterator : public Enumerable<T> {
+    const ListPair<T> *_pair;
+public:
+    ListIterator(const ListPair<T> *pair) : _pair(pair) { }
+    T current() const { return _pair->car(); }
+    void next() { _pair = _pair->cdr(); }
+    bool done() const { return _pair == NULL; }
+};
+
 template <class T>
 class List : public IList<T> {
     ListPair<T> *_list;
+    int _length;
 public:
-    List(T *items = NULL, int count = 0) : _list(NULL) {
+    typedef ListIterator<T> Iterator;
+    List(T *items = NULL, int count = 0) : _list(NULL), _length(0) {
         addAll(items, count);
     }
     void addAll(T *items, int count) {
@@ -75,6 +97,7 @@ public:
     }
     void add(T item) {
         _list = new ListPair<T>(item, _list);
+        _length++;
     }
     void clear() {
         while (_list) {
@@ -82,11 +105,12 @@ public:
             _list = _list->cdr();
             delete temp;
         }
+        _length = 0;
     }
     void remove(T item) {
         ListPair<T> *temp = _list;
-         NULL;
         _list = NULL;
+        _length = 0;
         while (temp) {
             T value = temp->car();
             ListPair<T> *dead = temp;
@@ -110,14 +134,11 @@ public:
     ListPair<T> *head() {
         return _list;
     }
+    Iterator items() const {
+        return Iterator(_list);
+    }
     int length() const {
-        int count = 0;
-        ListPair<T> *temp = _list;
-        while (temp) {
-            count++;
-            temp = temp->cdr();
-        }
-        return count;
+        return _length;
     }
     T item(int index) const {
         ListPair<T> *temp = _list;
@@ -135,30 +156,87 @@ int countZ(const T *itemsZ) {
     return count;
 }
 
-#else
+template <class T>
+class ArrayIterator : public Enumerable<T> {
+    const T *_item;
+    const T *_end;
+public:
+    ArrayIterator(const T *items, int count) : _item(items), _end(items + count) { }
+    T current() const { return *_item; }
+    void next() { _item++; }
+    bool done() const { return _item == _end; }
+};
 
-#define MAX_LIST_SIZE 30
+/*
+StaticList is a fixed-capacity List that never allocates, for boards where the heap
+is too precious (or too fragmented) to use.  It can stand in for List anywhere a list
+backend is a template parameter, e.g. Composite<Poller, StaticList<Poller*, 40> >.
+Unlike List, items come back in the order they were added.
 
-template <class T>
-class List : public IList<T> {
-    T _data[MAX_LIST_SIZE];
+Adding past the capacity drops the item and sets overflowed().  Initializing from an
+array that's bigger than the list is caught at compile time.
+*/
+template <class T, int N>
+class StaticList : public IList<T> {
+    static_assert(N > 0, "StaticList needs room for at least one item");
+    T _data[N];
     int _length;
+    bool _overflowed;
 public:
-    List() : _length(0) { }
+    typedef ArrayIterator<T> Iterator;
+    StaticList() : _length(0), _overflowed(false) { }
+    StaticList(T *items, int count) : _length(0), _overflowed(false) {
+        addAll(items, count);
+    }
+    template <int M>
+    StaticList(T (&items)[M]) : _length(0), _overflowed(false) {
+        static_assert(M <= N, "Too many items for this StaticList");
+        addAll(items, M);
+    }
+    static int capacity() { return N; }
+    void addAll(T *items, int count) {
+        for (int i = 0; i < count; i++) {
+            add(items[i]);
+        }
+    }
     void add(T item) {
-        _data[_length++] = item;
+        if (_length < N) {
+            _data[_length++] = item;
+        } else {
+            _overflowed = true;
+        }
+    }
+    void clear() {
+        _length = 0;
+    }
+    void remove(T item) {
+        int kept = 0;
+        for (int i = 0; i < _length; i++) {
+            if (_data[i] != item) {
+                _data[kept++] = _data[i];
+            }
+        }
+        _length = kept;
     }
+    bool contains(T item) const {
+        for (int i = 0; i < _length; i++) {
+            if (_data[i] == item) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool overflowed() const { return _overflowed; }
+    Iterator items() const { return Iterator(_data, _length); }
     int length() const { return _length; }
     T item(int index) const { return _data[index]; }
 };
 
-#endif
-
 // Just needed to test out the list thingy.
 int sum(List<int> &numbers) {
     int result = 0;
-    for (int i = 0; i < numbers.length(); i++) {
-        result += numbers[i];
+    for (List<int>::Iterator i = numbers.items(); !i.done(); i.next()) {
+        result += i.current();
     }
     return result;
 }
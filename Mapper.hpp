@@ -31,71 +31,136 @@ SOFTWARE.
 Mapper wraps the map() function in a composable object. See EncoderWheel.h for how it's used.
 Inverter is a controllable inverter. See DigitalLED for how it's used.
 Constrain holds a value to a certain range, but I haven't actually found a use for it yet.
+
+Pass onChange = true to any of these to only evaluate when an input has changed since
+the last evaluation.  That makes idle controls nearly free, but it means the output
+won't be rewritten if something else changes it behind the node's back.
 */
 
+/**
+ * ChangeDriven keeps the bookkeeping for nodes that can skip evaluation when their
+ * inputs haven't changed.  skipped() counts the evaluations each node avoided and
+ * totalSkipped() counts them across all nodes.
+ */
+class ChangeDriven {
+	const bool _onChange;
+	bool _evaluated;
+	unsigned long _skipped;
+protected:
+	ChangeDriven(bool onChange) : _onChange(onChange), _evaluated(false), _skipped(0) { }
+	bool shouldEvaluate(bool changed) {
+		if (!_onChange || changed || !_evaluated) {
+			_evaluated = true;
+			return true;
+		}
+		_skipped++;
+		totalSkippedCount()++;
+		return false;
+	}
+public:
+	bool onChange() const { return _onChange; }
+	unsigned long skipped() const { return _skipped; }
+	static unsigned long totalSkipped() { return totalSkippedCount(); }
+private:
+	static unsigned long &totalSkippedCount() {
+		static unsigned long count = 0;
+		return count;
+	}
+};
+
 template <class Tin, class Tout>
-class Mapper : public Scheduled {
+class Mapper : public Scheduled, public ChangeDriven {
 	Tin &_inValue;
 	Tout &_outValue;
 	const Tin _inLow;
 	const Tin _inHigh;
 	const Tout _outLow;
 	const Tout _outHigh;
+	Tin _lastIn;
 public:
-	Mapper(Schedule &schedule, Tin &inValue, Tout &outValue, Tin inLow, Tin inHigh, Tout outLow, Tout outHigh) : 
-		Scheduled(schedule), _inValue(inValue), _outValue(outValue), _inLow(inLow), _inHigh(inHigh), _outLow(outLow), _outHigh(outHigh) { }
+	Mapper(Schedule &schedule, Tin &inValue, Tout &outValue, Tin inLow, Tin inHigh, Tout outLow, Tout outHigh, bool onChange = false) : 
+		Scheduled(schedule), ChangeDriven(onChange), _inValue(inValue), _outValue(outValue), _inLow(inLow), _inHigh(inHigh), _outLow(outLow), _outHigh(outHigh), _lastIn() { }
 	void poll() {
-		_outValue = map(_inValue, _inLow, _inHigh, _outLow, _outHigh);
+		Tin current = _inValue;
+		if (shouldEvaluate(current != _lastIn)) {
+			_lastIn = current;
+			_outValue = map(current, _inLow, _inHigh, _outLow, _outHigh);
+		}
 	}
 };
 
-class Inverter : public Scheduled {
+class Inverter : public Scheduled, public ChangeDriven {
 	bool &_input;
 	bool &_output;
 	const bool _invert;
+	bool _lastIn;
 public:
-	Inverter(Schedule &schedule, bool &input, bool &output, bool invert = true) :
-		Scheduled(schedule), _input(input), _output(output), _invert(invert) { }
+	Inverter(Schedule &schedule, bool &input, bool &output, bool invert = true, bool onChange = false) :
+		Scheduled(schedule), ChangeDriven(onChange), _input(input), _output(output), _invert(invert), _lastIn(LOW) { }
 	void poll() {
 		// During initialization _input can have a garbage value
 		int temp = (int) _input;
 		if (temp == HIGH || temp == LOW) {
-			_output = (_input ^ _invert);
+			if (shouldEvaluate(_input != _lastIn)) {
+				_lastIn = _input;
+				_output = (_input ^ _invert);
+			}
 		}
 	}
 };
 
-class AndInputs : private Scheduled {
+class AndInputs : private Scheduled, public ChangeDriven {
 	bool &_a;
 	bool &_b;
 	bool &_x;
+	bool _lastA;
+	bool _lastB;
 public:
-	AndInputs(Schedule &schedule, bool &a, bool &b, bool &x) :
-		Scheduled(schedule), _a(a), _b(b), _x(x) { }
-	void poll() { _x = _a && _b; }
+	AndInputs(Schedule &schedule, bool &a, bool &b, bool &x, bool onChange = false) :
+		Scheduled(schedule), ChangeDriven(onChange), _a(a), _b(b), _x(x), _lastA(LOW), _lastB(LOW) { }
+	void poll() {
+		if (shouldEvaluate(_a != _lastA || _b != _lastB)) {
+			_lastA = _a;
+			_lastB = _b;
+			_x = _lastA && _lastB;
+		}
+	}
 };
 
-class OrInputs : private Scheduled {
+class OrInputs : private Scheduled, public ChangeDriven {
 	bool &_a;
 	bool &_b;
 	bool &_x;
+	bool _lastA;
+	bool _lastB;
 public:
-	OrInputs(Schedule &schedule, bool &a, bool &b, bool &x) :
-		Scheduled(schedule), _a(a), _b(b), _x(x) { }
-	void poll() { _x = _a || _b; }
+	OrInputs(Schedule &schedule, bool &a, bool &b, bool &x, bool onChange = false) :
+		Scheduled(schedule), ChangeDriven(onChange), _a(a), _b(b), _x(x), _lastA(LOW), _lastB(LOW) { }
+	void poll() {
+		if (shouldEvaluate(_a != _lastA || _b != _lastB)) {
+			_lastA = _a;
+			_lastB = _b;
+			_x = _lastA || _lastB;
+		}
+	}
 };
 
 template <class T>
-class Constrain : public Scheduled {
+class Constrain : public Scheduled, public ChangeDriven {
 	const T _min;
 	const T _max;
 	T &_input;
 	T &_output;
+	T _lastIn;
 public:
-	Constrain(Schedule &schedule, T &input, T &output, T minVal, T maxVal) :
-		Scheduled(schedule), _input(input), _output(output), _min(min(minVal, maxVal)), _max(max(minVal, maxVal)) { }
+	Constrain(Schedule &schedule, T &input, T &output, T minVal, T maxVal, bool onChange = false) :
+		Scheduled(schedule), ChangeDriven(onChange), _input(input), _output(output), _min(min(minVal, maxVal)), _max(max(minVal, maxVal)), _lastIn() { }
 	void poll() {
-		_output = constrain(_input, _min, _max);
+		T current = _input;
+		if (shouldEvaluate(current != _lastIn)) {
+			_lastIn = current;
+			_output = constrain(current, _min, _max);
+		}
 	}
 };
 
@@ -28,31 +28,514 @@ SOFTWARE.
 #include <Scheduler.hpp>
 
 /*
-Wrappers for reading/writing to pins.  (No support for interrupts yet.)
+Wrappers for reading/writing to pins.  DigitalRead samples the pin once a pass;
+InterruptRead (below) catches edges with an interrupt instead.
 See DigitalLED for an example.
 */
 
+/*
+PortSnapshot reads each input port that the schedule's DigitalReads use once, at the
+start of the pass, and they all take their bit from there.  That's one register read
+per port instead of a digitalRead() per pin, and every pin is seen as it was at the
+same instant, so an encoder's CLK and DT can't be read either side of a change.
+
+DigitalRead finds (or makes) the one for its schedule, so there's nothing to set up.
+Declare one before the DigitalReads to keep it off the heap:
+PortSnapshot ports(schedule);
+
+Where the port registers aren't known (boards other than AVR), or on a schedule that
+doesn't run passes, DigitalRead goes back to reading the pin directly.
+*/
+class PortSnapshot : public PassHook {
+	static const int MaxPorts = 6;
+	volatile uint8_t *_registers[MaxPorts];
+	uint8_t _ports[MaxPorts];
+	uint8_t _values[MaxPorts];
+	int _count;
+public:
+	static const int Kind = 'P';
+	PortSnapshot(Schedule &schedule) : _count(0) {
+		schedule.addHook(this);
+	}
+	static PortSnapshot *of(Schedule &schedule) {
+		if (!schedule.hasPasses()) {
+			return NULL;
+		}
+		PassHook *hook = schedule.findHook(Kind);
+		return hook ? static_cast<PortSnapshot*>(hook) : new PortSnapshot(schedule);
+	}
+	int kind() const { return Kind; }
+	// Where the pin's port is kept, or -1 if it can't be snapshotted.
+	int watch(int pin) {
+#if defined(__AVR__) || defined(ARDUINO_HOST)
+		uint8_t port = digitalPinToPort(pin);
+		if (port == NOT_A_PIN) {
+			return -1;
+		}
+		for (int i = 0; i < _count; i++) {
+			if (_ports[i] == port) {
+				return i;
+			}
+		}
+		if (_count < MaxPorts) {
+			_ports[_count] = port;
+			_registers[_count] = portInputRegister(port);
+			_values[_count] = *_registers[_count];
+			return _count++;
+		}
+#endif
+		return -1;
+	}
+	bool read(int index, uint8_t mask) const { return _values[index] & mask; }
+	void beginPass() {
+		for (int i = 0; i < _count; i++) {
+			_values[i] = *_registers[i];
+		}
+	}
+};
+
+/*
+PinIn is a pin that reads from its schedule's PortSnapshot where it can, and with
+digitalRead() where it can't.
+*/
+class PinIn {
+	int _pin;
+	PortSnapshot *_ports;
+	int _port;
+	uint8_t _mask;
+public:
+	PinIn() : _pin(-1), _ports(NULL), _port(-1), _mask(0) { }
+	PinIn(Schedule &schedule, int pin, int mode = INPUT_PULLUP) {
+		attach(schedule, pin, mode);
+	}
+	// For arrays of pins, which have to be made before the pins are known.
+	void attach(Schedule &schedule, int pin, int mode = INPUT_PULLUP) {
+		_pin = pin;
+		pinMode(pin, mode);
+		_ports = PortSnapshot::of(schedule);
+		_port = _ports ? _ports->watch(pin) : -1;
+		_mask = _port < 0 ? 0 : digitalPinToBitMask(pin);
+	}
+	int pin() const { return _pin; }
+	bool read() const {
+		return _port < 0 ? digitalRead(_pin) : _ports->read(_port, _mask);
+	}
+};
+
 class DigitalRead : public Scheduled {
 	bool &_value;
+	PinIn _pin;
+public:
+	DigitalRead(Schedule &schedule, int pin, bool &value, int mode = INPUT_PULLUP) :
+		Scheduled(schedule), _pin(schedule, pin, mode), _value(value) { }
+	void poll() {
+		_value = _pin.read();
+	}
+};
+
+/*
+InterruptLock holds off interrupts for as long as it's in scope, then puts them back
+the way they were, so it's safe where they might already be off (in a handler, say).
+Off AVR there's no SREG to save, so interrupts just come back on.
+
+Example:
+long copy() const {
+	InterruptLock lock;
+	return _shared;
+}
+*/
+class InterruptLock {
+#if defined(__AVR__) || defined(ARDUINO_HOST)
+	uint8_t _sreg;
+public:
+	InterruptLock() : _sreg(SREG) { noInterrupts(); }
+	~InterruptLock() { SREG = _sreg; }
+#else
+public:
+	InterruptLock() { noInterrupts(); }
+	~InterruptLock() { interrupts(); }
+#endif
+};
+
+/*
+PortLatch is the output side of PortSnapshot.  Writers stage their bits in a shadow
+of each output port during the pass, and at the end of the pass every port that was
+touched is written once.  LEDs and segments on the same port change together, and a
+seven segment display costs one port write instead of seven digitalWrite() calls.
+
+DigitalWrite (and so DigitalLED) and SevenSegLED find (or make) the one for their
+schedule.  Declare one to keep it off the heap:
+PortLatch latch(schedule);
+
+As with PortSnapshot, off AVR or on a schedule without passes the writers just call
+digitalWrite().
+
+A port write doesn't turn off PWM the way digitalWrite() does, so PinOut turns it off
+when it sets a latched pin up.  An analogWrite() on the pin after that takes it over
+again, so don't drive one pin with both AnalogWrite and a latched writer.
+*/
+class PortLatch : public PassHook {
+	static const int MaxPorts = 6;
+	volatile uint8_t *_registers[MaxPorts];
+	uint8_t _ports[MaxPorts];
+	uint8_t _set[MaxPorts];
+	uint8_t _clear[MaxPorts];
+	int _count;
+	unsigned long _commits;
+public:
+	static const int Kind = 'L';
+	PortLatch(Schedule &schedule) : _count(0), _commits(0) {
+		schedule.addHook(this);
+	}
+	static PortLatch *of(Schedule &schedule) {
+		if (!schedule.hasPasses()) {
+			return NULL;
+		}
+		PassHook *hook = schedule.findHook(Kind);
+		return hook ? static_cast<PortLatch*>(hook) : new PortLatch(schedule);
+	}
+	int kind() const { return Kind; }
+	// Where the pin's port is kept, or -1 if it can't be latched.
+	int watch(int pin) {
+#if defined(__AVR__) || defined(ARDUINO_HOST)
+		uint8_t port = digitalPinToPort(pin);
+		if (port == NOT_A_PIN) {
+			return -1;
+		}
+		for (int i = 0; i < _count; i++) {
+			if (_ports[i] == port) {
+				return i;
+			}
+		}
+		if (_count < MaxPorts) {
+			_ports[_count] = port;
+			_registers[_count] = portOutputRegister(port);
+			_set[_count] = 0;
+			_clear[_count] = 0;
+			return _count++;
+		}
+#endif
+		return -1;
+	}
+	void write(int index, uint8_t mask, bool value) {
+		if (value) {
+			_set[index] |= mask;
+			_clear[index] &= ~mask;
+		} else {
+			_clear[index] |= mask;
+			_set[index] &= ~mask;
+		}
+	}
+	// Number of port writes so far.
+	unsigned long commits() const { return _commits; }
+	void endPass() {
+		for (int i = 0; i < _count; i++) {
+			uint8_t set = _set[i];
+			uint8_t clear = _clear[i];
+			if (set | clear) {
+#ifdef ARDUINO_HOST
+				hostWritePort(_ports[i], set, clear);
+#else
+				// An interrupt handler might write the same port between the read and the write.
+				InterruptLock lock;
+				*_registers[i] = (*_registers[i] & ~clear) | set;
+#endif
+				_set[i] = 0;
+				_clear[i] = 0;
+				_commits++;
+			}
+		}
+	}
+};
+
+/*
+PinOut is a pin that writes through its schedule's PortLatch where it can, and with
+digitalWrite() where it can't.
+*/
+class PinOut {
 	const int _pin;
+	PortLatch *_latch;
+	int _port;
+	uint8_t _mask;
 public:
-	DigitalRead(Schedule &schedule, int pin, bool &value, int mode = INPUT_PULLUP) : Scheduled(schedule), _pin(pin), _value(value) {
-		pinMode(pin, mode);
+	PinOut(Schedule &schedule, int pin) : _pin(pin) {
+		pinMode(pin, OUTPUT);
+		_latch = PortLatch::of(schedule);
+		_port = _latch ? _latch->watch(pin) : -1;
+		_mask = _port < 0 ? 0 : digitalPinToBitMask(pin);
+		if (_port >= 0) {
+			// Port writes don't stop PWM the way digitalWrite() does, but digitalRead() does.
+			digitalRead(pin);
+		}
 	}
-	void poll() {
-		_value = digitalRead(_pin);
+	int pin() const { return _pin; }
+	void write(bool value) {
+		if (_port < 0) {
+			digitalWrite(_pin, value);
+		} else {
+			_latch->write(_port, _mask, value);
+		}
 	}
 };
 
+/*
+WriteCache is for outputs that only need to touch the hardware when their value
+changes.  write() says whether the value differs from the last one written; if not,
+the write is skipped and counted in elided() (and totalElided(), for all outputs).
+With a refresh time in milliseconds it lets the same value through once that long
+has passed, in case something else has changed the pin behind its back.
+*/
+class WriteCounts {
+public:
+	static unsigned long totalElided() { return totalElidedCount(); }
+protected:
+	static unsigned long &totalElidedCount() {
+		static unsigned long count = 0;
+		return count;
+	}
+};
+
+template <class T>
+class WriteCache : public WriteCounts {
+	T _last;
+	bool _written;
+	const long _refresh;
+	unsigned long _lastWrite;
+	unsigned long _elided;
+public:
+	WriteCache(long refresh = 0) : _written(false), _refresh(refresh), _lastWrite(0), _elided(0) { }
+	bool write(T value) {
+		if (_written && value == _last && (_refresh <= 0 || (long)(millis() - _lastWrite) < _refresh)) {
+			_elided++;
+			totalElidedCount()++;
+			return false;
+		}
+		_last = value;
+		_written = true;
+		_lastWrite = millis();
+		return true;
+	}
+	// Forget the last value, so the next write goes through.
+	void invalidate() { _written = false; }
+	unsigned long elided() const { return _elided; }
+};
+
 class DigitalWrite : public Scheduled {
 	bool &_value;
-	const int _pin;
+	PinOut _pin;
+	WriteCache<bool> _cache;
 public:
-	DigitalWrite(Schedule &schedule, bool &value, int pin) : Scheduled(schedule), _pin(pin), _value(value) {
-		pinMode(pin, OUTPUT);
+	DigitalWrite(Schedule &schedule, bool &value, int pin, long refresh = 0) :
+		Scheduled(schedule), _pin(schedule, pin), _value(value), _cache(refresh) { }
+	void poll() {
+		if (_cache.write(_value)) {
+			_pin.write(_value);
+		}
+	}
+	unsigned long elided() const { return _cache.elided(); }
+};
+
+/*
+PinEvent is one edge caught by an interrupt: when (micros()), which pin, and the level
+it changed to.
+*/
+struct PinEvent {
+	unsigned long time;
+	uint8_t pin;
+	bool level;
+};
+
+/*
+PinEventQueue is a ring buffer with one writer (an interrupt handler) and one reader
+(the loop).  That needs no locking: only push() moves _head and only pop() moves
+_tail, each is a single byte, and each is only moved after the slot it covers has
+been written or read.  N must be a power of two.  When the ring is full push() drops
+the event and counts it in overflows().
+*/
+template <int N = 16>
+class PinEventQueue {
+	static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0, "PinEventQueue size must be a power of two up to 128");
+	volatile unsigned long _time[N];
+	volatile uint8_t _pin[N];
+	volatile bool _level[N];
+	volatile uint8_t _head;
+	volatile uint8_t _tail;
+	volatile uint16_t _overflows;
+public:
+	PinEventQueue() : _head(0), _tail(0), _overflows(0) { }
+	bool push(unsigned long time, uint8_t pin, bool level) {
+		uint8_t head = _head;
+		uint8_t next = (head + 1) & (N - 1);
+		if (next == _tail) {
+			_overflows++;
+			return false;
+		}
+		_time[head] = time;
+		_pin[head] = pin;
+		_level[head] = level;
+		_head = next;
+		return true;
+	}
+	bool pop(PinEvent &event) {
+		uint8_t tail = _tail;
+		if (tail == _head) {
+			return false;
+		}
+		event.time = _time[tail];
+		event.pin = _pin[tail];
+		event.level = _level[tail];
+		_tail = (tail + 1) & (N - 1);
+		return true;
+	}
+	int length() const { return (_head - _tail) & (N - 1); }
+	bool empty() const { return _head == _tail; }
+	uint16_t overflows() const {
+		InterruptLock lock;
+		return _overflows;
+	}
+};
+
+/*
+InterruptInputs reads a few pins with CHANGE interrupts and queues every edge, so a
+pulse shorter than a pass isn't lost while the loop is busy (a display flush, say).
+Each poll() takes one event off the queue and writes its level to that pin's value,
+so an EdgeDetectorBase or Counter reading the value sees every edge, in the order they
+happened across all of the pins, one per pass.  A subclass that can deal with the
+events as they come (InterruptEncoderWheel does) overrides onEvent(), which is called
+after each value is written; returning true takes the next event in the same pass, so
+a backlog after a stall is cleared at once instead of overflowing.
+
+A pin without an interrupt (digitalPinToInterrupt() says NOT_AN_INTERRUPT), or one
+that doesn't fit in the handler table, is just sampled every pass like DigitalRead.
+
+The handler reads the pin after the interrupt, so a pulse shorter than that comes
+back as an event at the level the pin already had.  poll() takes one of those as the
+whole pulse: the opposite level first, then the one that was read (on the next pass,
+unless onEvent() takes it now), and counts it in shortPulses().
+
+overflows() is the number of edges dropped because the queue was full; if it's not
+zero the loop is too slow for the input.  time() is when the last event happened.
+
+Example:
+MainSchedule schedule;
+bool pulse;
+long pulses;
+InterruptRead pulseIn(schedule, 2, pulse);
+Counter counter(schedule, pulse, pulses);
+*/
+class InterruptInputs : public Scheduled {
+	static const int MaxPins = 4;
+	static const int Handlers = 8;
+	struct Handler {
+		InterruptInputs *owner;
+		uint8_t pin;
+	};
+	PinEventQueue<> _queue;
+	uint8_t _pins[MaxPins];
+	bool *_values[MaxPins];
+	bool _sampled[MaxPins];
+	int _count;
+	unsigned long _time;
+	PinEvent _held; // the second half of a short pulse
+	bool _holding;
+	uint16_t _shortPulses;
+	// One table for all instances, since attachInterrupt() takes a plain function.
+	static Handler *handlers() {
+		static Handler table[Handlers];
+		return table;
+	}
+	template <int I>
+	static void handle() {
+		Handler &h = handlers()[I];
+		h.owner->_queue.push(micros(), h.pin, digitalRead(h.pin));
+	}
+	static void (*handlerFor(int i))() {
+		static void (*const table[Handlers])() = {
+			handle<0>, handle<1>, handle<2>, handle<3>, handle<4>, handle<5>, handle<6>, handle<7>
+		};
+		return table[i];
+	}
+	bool attach(int pin) {
+		int interrupt = digitalPinToInterrupt(pin);
+		if (interrupt == NOT_AN_INTERRUPT) return false;
+		for (int i = 0; i < Handlers; i++) {
+			if (handlers()[i].owner == NULL) {
+				handlers()[i].owner = this;
+				handlers()[i].pin = pin;
+				attachInterrupt(interrupt, handlerFor(i), CHANGE);
+				return true;
+			}
+		}
+		return false;
+	}
+	// The next edge to deliver, filling in the missing half of a short pulse.
+	bool next(PinEvent &event) {
+		if (_holding) {
+			_holding = false;
+			event = _held;
+			return true;
+		}
+		if (!_queue.pop(event)) {
+			return false;
+		}
+		for (int i = 0; i < _count; i++) {
+			if (_pins[i] == event.pin && *_values[i] == event.level) {
+				_held = event;
+				_holding = true;
+				_shortPulses++;
+				event.level = !event.level;
+			}
+		}
+		return true;
+	}
+public:
+	InterruptInputs(Schedule &schedule) : Scheduled(schedule), _count(0), _time(0), _holding(false), _shortPulses(0) { }
+	// Returns false if this already has as many pins as it can take.
+	bool add(int pin, bool &value, int mode = INPUT_PULLUP) {
+		if (_count == MaxPins) return false;
+		pinMode(pin, mode);
+		value = digitalRead(pin);
+		_pins[_count] = pin;
+		_values[_count] = &value;
+		_sampled[_count] = !attach(pin);
+		_count++;
+		return true;
 	}
 	void poll() {
-		digitalWrite(_pin, _value);
+		PinEvent event;
+		while (next(event)) {
+			_time = event.time;
+			for (int i = 0; i < _count; i++) {
+				if (_pins[i] == event.pin) {
+					*_values[i] = event.level;
+				}
+			}
+			if (!onEvent(event)) {
+				break;
+			}
+		}
+		for (int i = 0; i < _count; i++) {
+			if (_sampled[i]) {
+				*_values[i] = digitalRead(_pins[i]);
+			}
+		}
+	}
+	// Return true to be given the next queued event in the same pass.
+	virtual bool onEvent(const PinEvent &) { return false; }
+	uint16_t overflows() const { return _queue.overflows(); }
+	// Pulses too short for the handler to read the level in between.
+	uint16_t shortPulses() const { return _shortPulses; }
+	int pending() const {
+		InterruptLock lock;
+		return _queue.length();
+	}
+	unsigned long time() const { return _time; }
+};
+
+class InterruptRead : public InterruptInputs {
+public:
+	InterruptRead(Schedule &schedule, int pin, bool &value, int mode = INPUT_PULLUP) : InterruptInputs(schedule) {
+		add(pin, value, mode);
 	}
 };
 
@@ -73,13 +556,18 @@ template <class T>
 class AnalogWrite : public Scheduled {
 	const int _pin;
 	T &_value;
+	WriteCache<T> _cache;
 public:
-	AnalogWrite(Schedule &schedule, T &value, int pin) : Scheduled(schedule), _pin(pin), _value(value) {
+	AnalogWrite(Schedule &schedule, T &value, int pin, long refresh = 0) :
+		Scheduled(schedule), _pin(pin), _value(value), _cache(refresh) {
 		pinMode(pin, OUTPUT);
 	}
 	void poll() {
-		analogWrite(_pin, _value);
+		if (_cache.write(_value)) {
+			analogWrite(_pin, _value);
+		}
 	}
+	unsigned long elided() const { return _cache.elided(); }
 };
 
 #endif
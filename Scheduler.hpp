@@ -27,12 +27,15 @@ SOFTWARE.
 
 /*
 MainSchedule provides a single pollable object for all pollers.
-Current uses hardcoded limit of 50 pollable objects to avoid dynamic allocation.
-Change the MAX_POLLERS if it's insufficient.  Unfortuantely there really isn't a good
-way to tell when you've exceeded the max at this point.
+By default it keeps them in a List, which allocates a node per poller.  To avoid
+dynamic allocation use StaticMainSchedule<N>, which holds at most N pollers.
+If more than N try to register, schedule.overflowed() turns true, and begin()
+stops and flashes LED_BUILTIN so it won't go unnoticed.
 
 All pollable objects should take schedule as the first parameter, and add themselves
-to ensure they get into the polling loop.
+to ensure they get into the polling loop.  Things that only care about time (see
+ScheduledTimer in Clock.hpp) wait in the schedule's deadline queue instead, and are
+only called when they're due.
 
 Example:
 MainSchedule schedule;
@@ -71,68 +74,223 @@ public:
 	virtual void toggle() = 0;
 };
 
-template <class T>
-class Composite : public List<T*>, public T {
+/*
+Composites walk their items with an Iterator rather than item(i), since item(i)
+has to walk the list from the head every time.  The list backend is a template
+parameter so a composite can use a StaticList instead of allocating.
+*/
+template <class T, class L = List<T*> >
+class Composite : public L, public T {
 public:
-	Composite(T *items[] = NULL, int count = 0) : List<T*>(items, count) { }
+	typedef typename L::Iterator Iterator;
+	Composite(T *items[] = NULL, int count = 0) : L(items, count) { }
 };
 
-class PressComposite : public Composite<Pressable> {
+template <class L = List<Pressable*> >
+class PressCompositeOf : public Composite<Pressable, L> {
+	typedef typename L::Iterator Iterator;
 public:
-	PressComposite(Pressable *itemsZ[] = NULL) :
-		Composite<Pressable>(itemsZ, countZ(itemsZ)) { }
+	PressCompositeOf(Pressable *itemsZ[] = NULL) :
+		Composite<Pressable, L>(itemsZ, countZ(itemsZ)) { }
 	void press() {
-		for (int i = 0; i < length(); i++) {
-			item(i)->press();
+		for (Iterator i = this->items(); !i.done(); i.next()) {
+			i.current()->press();
 		}
 	}
 	void release() {
-		for (int i = 0; i < length(); i++) {
-			item(i)->release();
+		for (Iterator i = this->items(); !i.done(); i.next()) {
+			i.current()->release();
 		}
 	}
 };
 
-class EnableComposite : public Composite<Enabled> {
+typedef PressCompositeOf<> PressComposite;
+
+template <class L = List<Enabled*> >
+class EnableCompositeOf : public Composite<Enabled, L> {
+	typedef typename L::Iterator Iterator;
 public:
-	EnableComposite(Enabled *itemsZ[] = NULL) :
-		Composite<Enabled>(itemsZ, countZ(itemsZ)) { }
+	EnableCompositeOf(Enabled *itemsZ[] = NULL) :
+		Composite<Enabled, L>(itemsZ, countZ(itemsZ)) { }
 	void enable(bool value) {
-		for (int i = 0; i < length(); i++) {
-			item(i)->enable(value);
+		for (Iterator i = this->items(); !i.done(); i.next()) {
+			i.current()->enable(value);
 		}
 	}
 	void toggle() {
-		for (int i = 0; i < length(); i++) {
-			item(i)->toggle();
+		for (Iterator i = this->items(); !i.done(); i.next()) {
+			i.current()->toggle();
+		}
+	}
+};
+
+typedef EnableCompositeOf<> EnableComposite;
+
+/*
+Deadline is for objects that only need attention at a known time (clocks, timers)
+rather than on every pass.  They wait in their schedule's DeadlineQueue, and onDue()
+is called on the first pass after their time has come.  The queue keeps itself sorted
+by due time, so a pass where nothing is due costs one comparison.
+*/
+class Deadline {
+	friend class DeadlineQueue;
+	Deadline *_nextDue;
+	unsigned long _due;
+	bool _queued;
+public:
+	Deadline() : _nextDue(NULL), _due(0), _queued(false) { }
+	bool queued() const { return _queued; }
+	virtual void onDue() = 0;
+};
+
+class DeadlineQueue {
+	Deadline *_head;
+	// Compare as a signed difference so millis() rolling over doesn't matter.
+	static bool before(unsigned long a, unsigned long b) { return (long)(a - b) < 0; }
+public:
+	DeadlineQueue() : _head(NULL) { }
+	void schedule(Deadline *item, unsigned long due) {
+		cancel(item);
+		item->_due = due;
+		item->_queued = true;
+		Deadline **link = &_head;
+		while (*link && !before(due, (*link)->_due)) {
+			link = &(*link)->_nextDue;
+		}
+		item->_nextDue = *link;
+		*link = item;
+	}
+	void cancel(Deadline *item) {
+		if (!item->_queued) return;
+		for (Deadline **link = &_head; *link; link = &(*link)->_nextDue) {
+			if (*link == item) {
+				*link = item->_nextDue;
+				break;
+			}
+		}
+		item->_nextDue = NULL;
+		item->_queued = false;
+	}
+	void poll(unsigned long now) {
+		while (_head && !before(now, _head->_due)) {
+			Deadline *item = _head;
+			_head = item->_nextDue;
+			item->_nextDue = NULL;
+			item->_queued = false;
+			item->onDue();
+		}
+	}
+};
+
+/*
+PassHook is called at the start and end of every pass of the schedule it's added to,
+around all of the pollers.  It's for stages that batch work over a whole pass, like
+reading each input port once (see PortSnapshot in PinIO.hpp).  kind() lets several
+objects find and share one hook rather than each adding their own.  Hooks run in the
+order they were added, so a hook can rely on one it made first (ButtonBank reads its
+buttons from the PortSnapshot).
+*/
+class PassHook {
+	friend class Schedule;
+	PassHook *_nextHook;
+public:
+	PassHook() : _nextHook(NULL) { }
+	virtual void beginPass() { }
+	virtual void endPass() { }
+	virtual int kind() const { return 0; }
+};
+
+/*
+Schedule is what pollable objects register with.  It doesn't care how the pollers
+are stored; see PollerCompositeOf.
+*/
+class Schedule : public Poller {
+	DeadlineQueue _deadlines;
+	PassHook *_hooks;
+public:
+	Schedule() : _hooks(NULL) { }
+	virtual void add(Poller *item) = 0;
+	virtual bool overflowed() const { return false; }
+	// False if nothing polls this schedule as a whole pass (see ManualSchedule), so
+	// pass hooks would never run.
+	virtual bool hasPasses() const { return true; }
+	DeadlineQueue &deadlines() { return _deadlines; }
+	void addHook(PassHook *hook) {
+		PassHook **link = &_hooks;
+		while (*link) {
+			link = &(*link)->_nextHook;
+		}
+		hook->_nextHook = NULL;
+		*link = hook;
+	}
+	PassHook *findHook(int kind) const {
+		for (PassHook *hook = _hooks; hook; hook = hook->_nextHook) {
+			if (hook->kind() == kind) {
+				return hook;
+			}
+		}
+		return NULL;
+	}
+protected:
+	void beginPass() {
+		for (PassHook *hook = _hooks; hook; hook = hook->_nextHook) {
+			hook->beginPass();
+		}
+	}
+	void endPass() {
+		for (PassHook *hook = _hooks; hook; hook = hook->_nextHook) {
+			hook->endPass();
 		}
 	}
 };
 
-class PollerComposite : public Composite<Poller> {
+template <class L = List<Poller*> >
+class PollerCompositeOf : public Schedule, public L {
 public:
-	PollerComposite(Poller *itemsZ[] = NULL) :
-		Composite<Poller>(itemsZ, countZ(itemsZ)) { }
+	typedef typename L::Iterator Iterator;
+	PollerCompositeOf(Poller *itemsZ[] = NULL) : L(itemsZ, countZ(itemsZ)) { }
+	void add(Poller *item) { L::add(item); }
+	bool overflowed() const { return L::overflowed(); }
 	void poll() {
-		for (int i = 0; i < length(); i++) {
-			item(i)->poll();
+		beginPass();
+		for (Iterator i = this->items(); !i.done(); i.next()) {
+			i.current()->poll();
 		}
+		deadlines().poll(millis());
+		endPass();
 	}
 };
 
-typedef PollerComposite Schedule;
+typedef PollerCompositeOf<> PollerComposite;
 
-class MainSchedule : public Schedule {
+template <class L = List<Poller*> >
+class MainScheduleOf : public PollerCompositeOf<L> {
 public:
-	MainSchedule() { }
+	MainScheduleOf() { }
 	void begin() {
+		if (this->overflowed()) {
+			// Too many pollers for a fixed-size schedule.  Flash the LED rather than
+			// run with some of them silently missing.
+			pinMode(LED_BUILTIN, OUTPUT);
+			for (;;) {
+				digitalWrite(LED_BUILTIN, HIGH);
+				delay(100);
+				digitalWrite(LED_BUILTIN, LOW);
+				delay(100);
+			}
+		}
 		// Let transient effects work themselves out.
 		for (int i = 0; i < 25; i++) {
-			poll();
+			this->poll();
 		}
 	}
 };
 
+typedef MainScheduleOf<> MainSchedule;
+
+template <int N>
+using StaticMainSchedule = MainScheduleOf<StaticList<Poller*, N> >;
+
 class Scheduled : public Poller {
 public:
 	Scheduled(Schedule &schedule) {
@@ -140,12 +298,67 @@ public:
 	}
 };
 
+/*
+StaticSchedule builds a fixed poll sequence at compile time for objects that are wired
+up once at global scope.  Each poll() is called by its exact type, so the compiler can
+inline it instead of going through the vtable, and nothing is allocated per object.
+Construct the objects with a ManualSchedule so they aren't also added to a list.
+StaticSchedule can sit alongside MainSchedule; just poll both in loop().
+
+Example:
+MainSchedule schedule;
+ManualSchedule manual;
+bool ledState, ledOn;
+long ledDelay = 200;
+Clock ledClock(schedule, ledDelay, ledDelay, ledState);
+Inverter inverter(manual, ledState, ledOn, false);
+DigitalWrite led(manual, ledOn, LED_BUILTIN);
+StaticSchedule<Inverter, DigitalWrite> fixed(inverter, led);
+void loop() {
+	schedule.poll();
+	fixed.poll();
+}
+*/
+template <class... Ts>
+class StaticSchedule;
+
+template <>
+class StaticSchedule<> {
+public:
+	void poll() { }
+};
+
+template <class T, class... Ts>
+class StaticSchedule<T, Ts...> : private StaticSchedule<Ts...> {
+	T &_item;
+public:
+	StaticSchedule(T &item, Ts&... items) : StaticSchedule<Ts...>(items...), _item(item) { }
+	void poll() {
+		_item.T::poll();
+		StaticSchedule<Ts...>::poll();
+	}
+};
+
+/*
+ManualSchedule doesn't keep a list, so anything constructed with it is only polled
+when something else (like a StaticSchedule) polls it.  Timers still work if the
+ManualSchedule itself is polled, since that services its deadline queue.  There are
+no passes, so pass hooks don't apply (a DigitalRead just reads its pin directly).
+*/
+class ManualSchedule : public Schedule {
+public:
+	void add(Poller *) { }
+	bool hasPasses() const { return false; }
+	void poll() { deadlines().poll(millis()); }
+};
+
 class PollGroup : public PollerComposite, public Scheduled, public Enabled {
 	bool _enabled;
 public:
-	PollGroup(Schedule &schedule) : Scheduled(schedule) { }
+	PollGroup(Schedule &schedule) : Scheduled(schedule), _enabled(true) { }
 	void enable(bool value) { _enabled = value; }
 	void toggle() { enable(!_enabled); }
+	bool enabled() const { return _enabled; }
 	void poll() {
 		if (_enabled) {
 			PollerComposite::poll();
@@ -153,4 +366,125 @@ public:
 	}
 };
 
+/*
+Rate groups are PollGroups that don't poll their members on every pass, so slow or
+heavy work (plots, display redraws, pot reads) can be throttled while encoders and
+buttons stay on the main schedule at full rate.
+
+RateGroup polls every Nth pass; phase picks which one, so two heavy groups with the
+same divisor can be kept off the same pass.  TimedGroup polls at most once every
+period microseconds, starting phase microseconds after it's created.  Either way the
+members' own deadline queue is serviced when the group runs.
+
+passes() counts passes while enabled, polls() how many of those ran the members, and
+pollsPerSecond() is the effective rate since the last resetStats().  printStats()
+prints the lot as CSV: passes,polls,pollsPerSecond,meanUs,maxUs.
+
+Example:
+MainSchedule schedule;
+EncoderWheel wheel(schedule, 2, 3, value);        // every pass
+RateGroup display(schedule, 4, 1);                // passes 1, 5, 9...
+RateGroup plots(schedule, 4, 3);                  // passes 3, 7, 11...
+TimedGroup pots(schedule, 20000);                 // every 20ms
+MainWindow window(display, oled);
+SerialPlot plot(plots);
+*/
+class RateGroupBase : public PollGroup {
+	unsigned long _passes;
+	unsigned long _polls;
+	unsigned long _totalUs;
+	unsigned long _maxUs;
+	unsigned long _since;
+public:
+	RateGroupBase(Schedule &schedule) : PollGroup(schedule) { resetStats(); }
+	void poll() {
+		if (!enabled()) return;
+		_passes++;
+		if (due()) {
+			unsigned long start = micros();
+			PollerComposite::poll();
+			unsigned long time = micros() - start;
+			_polls++;
+			_totalUs += time;
+			if (time > _maxUs) _maxUs = time;
+		}
+	}
+	unsigned long passes() const { return _passes; }
+	unsigned long polls() const { return _polls; }
+	unsigned long maxUs() const { return _maxUs; }
+	unsigned long meanUs() const { return _polls ? _totalUs / _polls : 0; }
+	float pollsPerSecond() const {
+		unsigned long elapsed = micros() - _since;
+		return elapsed ? _polls * 1000000.0 / elapsed : 0;
+	}
+	void resetStats() {
+		_passes = 0;
+		_polls = 0;
+		_totalUs = 0;
+		_maxUs = 0;
+		_since = micros();
+	}
+	void printStats() {
+		Serial.print((long)_passes, DEC);
+		Serial.print(",");
+		Serial.print((long)_polls, DEC);
+		Serial.print(",");
+		Serial.print(pollsPerSecond(), 1);
+		Serial.print(",");
+		Serial.print((long)meanUs(), DEC);
+		Serial.print(",");
+		Serial.println((long)_maxUs, DEC);
+	}
+protected:
+	// Called once per enabled pass; true if the members should be polled this time.
+	virtual bool due() = 0;
+};
+
+class RateGroup : public RateGroupBase {
+	unsigned int _divisor;
+	unsigned int _phase;
+	unsigned int _count;
+public:
+	RateGroup(Schedule &schedule, unsigned int divisor, unsigned int phase = 0) :
+		RateGroupBase(schedule), _divisor(divisor ? divisor : 1), _count(0) {
+		_phase = phase % _divisor;
+	}
+	unsigned int divisor() const { return _divisor; }
+protected:
+	bool due() {
+		bool result = _count == _phase;
+		if (++_count >= _divisor) {
+			_count = 0;
+		}
+		return result;
+	}
+};
+
+class TimedGroup : public RateGroupBase {
+	unsigned long _period;
+	unsigned long _next;
+	// Compare as a signed difference so micros() rolling over doesn't matter.
+	static bool before(unsigned long a, unsigned long b) { return (long)(a - b) < 0; }
+public:
+	TimedGroup(Schedule &schedule, unsigned long period, unsigned long phase = 0) :
+		RateGroupBase(schedule), _period(period) {
+		_next = micros() + phase;
+	}
+	unsigned long period() const { return _period; }
+protected:
+	bool due() {
+		unsigned long now = micros();
+		if (before(now, _next)) {
+			return false;
+		}
+		// Stay on the original cadence, but don't try to catch up on a run of
+		// missed periods all at once.
+		_next += _period;
+		if (before(_next, now)) {
+			_next = now + _period;
+		}
+		return true;
+	}
+};
+
 #endif
@@ -4,106 +4,400 @@
 #include <Scheduler.hpp>
 #include <EdgeDetector.hpp>
 
+/*
+Every channel name gets a small id the first time it's seen, whether from a plotted
+item or a +name command, and keeps it for the life of the sketch.  Channels keeps
+the shown ids as bits, so asking if a channel is shown is a single bit test however
+many channels there are; names are only looked up when a command comes in.
+
+ALL shows every channel, including ones registered later, and -name still hides
+one of them; NONE hides everything until +name.
+
+Example:
+int speed = Channels::id("speed");
+Channels channels;
+channels.showNone();
+channels.add("speed");
+if (channels.contains(speed)) { ... }
+*/
 class Channels {
-    List<String> _names;
+    // The name of every id, shared by all Channels.
+    struct Names {
+        String *items;
+        int count;
+        int capacity;
+    };
+    static Names &names() {
+        static Names names = { NULL, 0, 0 };
+        return names;
+    }
+    bool _all;
+    uint8_t *_shown;
+    int _size;
+    Channels(const Channels &);
+    Channels &operator=(const Channels &);
 public:
-    Channels() { showAll(); }
-    void showAll() { _names.clear(); _names.add("ALL"); }
-    void showNone() { _names.clear(); }
-    bool contains(String name) const { return _names.contains("ALL") || _names.contains(name); }
-    bool add(String name) {
-        if (!_names.contains(name)) {
-            _names.add(name);
+    static const int None = -1;
+    static int find(const String &name) {
+        Names &n = names();
+        for (int i = 0; i < n.count; i++) {
+            if (n.items[i] == name) {
+                return i;
+            }
         }
+        return None;
     }
-    bool remove(String name) {
-        if (_names.contains(name)) {
-            _names.remove(name);
+    static int id(const String &name) {
+        int result = find(name);
+        if (result == None) {
+            Names &n = names();
+            if (n.count == n.capacity) {
+                int capacity = n.capacity ? n.capacity << 1 : 8;
+                String *items = new String[capacity];
+                for (int i = 0; i < n.count; i++) {
+                    items[i] = n.items[i];
+                }
+                delete[] n.items;
+                n.items = items;
+                n.capacity = capacity;
+            }
+            n.items[n.count] = name;
+            result = n.count++;
         }
+        return result;
+    }
+    static const String &name(int id) { return names().items[id]; }
+    static int count() { return names().count; }
+
+    Channels() : _all(true), _shown(NULL), _size(0) { }
+    ~Channels() { delete[] _shown; }
+    void showAll() { fill(true); }
+    void showNone() { fill(false); }
+    bool contains(int id) const {
+        return (id >> 3) < _size ? (_shown[id >> 3] >> (id & 7)) & 1 : _all;
+    }
+    bool contains(const String &name) const {
+        int i = find(name);
+        return i == None ? _all : contains(i);
+    }
+    bool add(int id) {
+        if (contains(id)) {
+            return false;
+        }
+        reserve(id);
+        _shown[id >> 3] |= 1 << (id & 7);
+        return true;
+    }
+    bool add(const String &name) { return add(id(name)); }
+    bool remove(int id) {
+        if (!contains(id)) {
+            return false;
+        }
+        reserve(id);
+        _shown[id >> 3] &= ~(1 << (id & 7));
+        return true;
+    }
+    bool remove(const String &name) {
+        int i = find(name);
+        return i == None ? false : remove(i);
     }
     void print() {
-        for (int i = 0; i < _names.length(); i++) {
-            if (i != 0) Serial.print(",");
-            Serial.print(_names[i]);
+        bool sep = false;
+        for (int i = 0; i < count(); i++) {
+            if (contains(i)) {
+                if (sep) Serial.print(",");
+                Serial.print(name(i));
+                sep = true;
+            }
         }
     }
     void println() {
         print();
         Serial.println();
     }
+private:
+    void fill(bool shown) {
+        _all = shown;
+        for (int i = 0; i < _size; i++) {
+            _shown[i] = shown ? 0xFF : 0;
+        }
+    }
+    // Makes room for the bit for id; new bits follow ALL or NONE.
+    void reserve(int id) {
+        int size = (id >> 3) + 1;
+        if (size > _size) {
+            uint8_t *shown = new uint8_t[size];
+            for (int i = 0; i < size; i++) {
+                shown[i] = i < _size ? _shown[i] : (_all ? 0xFF : 0);
+            }
+            delete[] _shown;
+            _shown = shown;
+            _size = size;
+        }
+    }
 };
 
+/*
+PlotFrame builds one binary record for SerialPlot's binary mode and sends it as
+COBS frames: the bytes are stuffed so that a zero only ever appears as the end of a
+frame, which lets the host find the next record after a dropped or garbled one.
+
+A frame is a type byte, the fields, then an XOR of all of them.  Numbers go out as
+varints (zigzagged if signed), so small values take a single byte; floats are four
+bytes, little-endian.  The records are:
+
+  'T' index type name            one per channel, index 0 first; describes the samples
+  'E' count                      ends the table; it only takes effect once this arrives
+  'S' sequence part values...    one value per channel in table order
+
+The sequence wraps at 256.  A sample that doesn't fit in one frame is split over as
+many as it takes, each with the same sequence and the next part number (from 0),
+with the top bit of part set on all but the last; the host puts the values back
+together, and a sample missing a part is thrown away whole.  Type is 'b' (bool), 'i'
+(signed), 'u' (unsigned) or 'f' (float).  A 'T' record that doesn't fit (a name of
+over 120 or so characters) isn't sent, and is counted in oversize(); the host sees
+the table as incomplete.  tools/plot_decode.py turns the frames back into CSV.
+*/
+class PlotFrame {
+public:
+    // Under 254, so a frame never has a run of non-zero bytes too long for one block.
+    static const int MaxSize = 128;
+private:
+    static const uint8_t MoreParts = 0x80;
+    Print &_out;
+    uint8_t _data[MaxSize];
+    int _size;
+    bool _overflowed;
+    bool _sample;
+    unsigned long _oversize;
+public:
+    PlotFrame(Print &out = Serial) : _out(out), _size(0), _overflowed(false), _sample(false), _oversize(0) { }
+    void begin(char type) {
+        _size = 0;
+        _overflowed = false;
+        _sample = false;
+        putByte(type);
+    }
+    // An 'S' record, which is split into parts if it needs to be.
+    void beginSample(uint8_t sequence) {
+        begin('S');
+        putByte(sequence);
+        putByte(0);
+        _sample = true;
+    }
+    void putByte(uint8_t value) {
+        if (_size == MaxSize - 1) { // leave room for the check byte
+            if (_sample && _data[2] < MoreParts - 1) {
+                // Send what there is as one part and carry on in the next.
+                uint8_t part = _data[2];
+                _data[2] = part | MoreParts;
+                send();
+                _size = 3;
+                _data[2] = part + 1;
+            } else {
+                _overflowed = true;
+                return;
+            }
+        }
+        _data[_size++] = value;
+    }
+    void putUnsigned(unsigned long value) {
+        while (value >= 0x80) {
+            putByte((uint8_t)value | 0x80);
+            value >>= 7;
+        }
+        putByte((uint8_t)value);
+    }
+    void putSigned(long value) {
+        putUnsigned(((unsigned long)value << 1) ^ (unsigned long)(value >> (sizeof(long) * 8 - 1)));
+    }
+    void putFloat(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 4; i++, bits >>= 8) {
+            putByte((uint8_t)bits);
+        }
+    }
+    void putName(const String &name) {
+        for (unsigned int i = 0; i < name.length(); i++) {
+            putByte(name[i]);
+        }
+    }
+    void put(bool value) { putByte(value); }
+    void put(signed char value) { putSigned(value); }
+    void put(unsigned char value) { putUnsigned(value); }
+    void put(int value) { putSigned(value); }
+    void put(unsigned int value) { putUnsigned(value); }
+    void put(long value) { putSigned(value); }
+    void put(unsigned long value) { putUnsigned(value); }
+    void put(float value) { putFloat(value); }
+    void put(double value) { putFloat((float)value); }
+    static char typeOf(bool) { return 'b'; }
+    static char typeOf(signed char) { return 'i'; }
+    static char typeOf(unsigned char) { return 'u'; }
+    static char typeOf(int) { return 'i'; }
+    static char typeOf(unsigned int) { return 'u'; }
+    static char typeOf(long) { return 'i'; }
+    static char typeOf(unsigned long) { return 'u'; }
+    static char typeOf(float) { return 'f'; }
+    static char typeOf(double) { return 'f'; }
+    int size() const { return _size; }
+    bool overflowed() const { return _overflowed; }
+    // Records dropped because they didn't fit.
+    unsigned long oversize() const { return _oversize; }
+    // Sends the record (or its last part); false, and nothing sent, if it overflowed.
+    bool end() {
+        if (_overflowed) {
+            _oversize++;
+            return false;
+        }
+        send();
+        return true;
+    }
+private:
+    // Adds the check byte and sends _data as one frame.
+    void send() {
+        uint8_t check = 0;
+        for (int i = 0; i < _size; i++) {
+            check ^= _data[i];
+        }
+        _data[_size] = check;
+        int size = _size + 1;
+        // Each zero (and the end) closes a block headed by its distance from the last.
+        int start = 0;
+        for (int i = 0; i <= size; i++) {
+            if (i == size || _data[i] == 0) {
+                _out.write((uint8_t)(i - start + 1));
+                _out.write(_data + start, i - start);
+                start = i + 1;
+            }
+        }
+        _out.write((uint8_t)0);
+    }
+};
+
+/*
+Plotted items print themselves as name:value for the Arduino serial plotter.  For
+binary mode they also describe() their channel for the table and sample() their
+value into a record; both only do anything when the channel is shown, and the two
+must agree so the values line up with the table.
+*/
 class Plotted {
 public:
     virtual bool plot(Channels &channels, bool sep = false) = 0;
+    virtual void describe(Channels &, PlotFrame &, uint8_t &) { }
+    virtual void sample(Channels &, PlotFrame &) { }
 };
 
 class PlotComposite : public Composite<Plotted> {
 public:
     bool plot(Channels &channels, bool sep = false) {
         bool result = sep;
-        for (int i = 0; i < length(); i++) {
-            result |= item(i)->plot(channels, result);
+        for (Iterator i = items(); !i.done(); i.next()) {
+            result |= i.current()->plot(channels, result);
         }
         return result;
     }
-};
-
-class PlotBool : public Plotted {
-    String _name;
-    bool &_value;
-public:
-    PlotBool(PlotComposite &plot, String name, bool &value) : _name(name), _value(value) { plot.add(this); }
-    bool plot(Channels &channels, bool sep = false) {
-        if (channels.contains(_name)) {
-            if (sep) {
-                Serial.print(",");
-            }
-            Serial.print(_name);
-            Serial.print(":");
-            Serial.print(_value, DEC);
-            return true;
+    void describe(Channels &channels, PlotFrame &frame, uint8_t &index) {
+        for (Iterator i = items(); !i.done(); i.next()) {
+            i.current()->describe(channels, frame, index);
         }
-        return false;
     }
-    static void addToPlot(PlotComposite &plot, String name, bool &value) {
-        new PlotBool(plot, name, value);
+    void sample(Channels &channels, PlotFrame &frame) {
+        for (Iterator i = items(); !i.done(); i.next()) {
+            i.current()->sample(channels, frame);
+        }
     }
 };
 
 template <class T>
 class PlotNum : public Plotted {
-    String _name;
+    const int _id;
     T &_value;
 public:
-    PlotNum(PlotComposite &plot, String name, T &value) : _name(name), _value(value) { plot.add(this); }
+    PlotNum(PlotComposite &plot, String name, T &value) : _id(Channels::id(name)), _value(value) { plot.add(this); }
+    int id() const { return _id; }
     bool plot(Channels &channels, bool sep = false) {
-        if (channels.contains(_name)) {
+        if (channels.contains(_id)) {
             if (sep) {
                 Serial.print(",");
             }
-            Serial.print(_name);
+            Serial.print(Channels::name(_id));
             Serial.print(":");
             Serial.print(_value, DEC);
             return true;
         }
         return false;
     }
+    void describe(Channels &channels, PlotFrame &frame, uint8_t &index) {
+        if (channels.contains(_id)) {
+            frame.begin('T');
+            frame.putByte(index++);
+            frame.putByte(PlotFrame::typeOf(_value));
+            frame.putName(Channels::name(_id));
+            frame.end();
+        }
+    }
+    void sample(Channels &channels, PlotFrame &frame) {
+        if (channels.contains(_id)) {
+            frame.put(_value);
+        }
+    }
+};
+
+class PlotBool : public PlotNum<bool> {
+public:
+    PlotBool(PlotComposite &plot, String name, bool &value) : PlotNum<bool>(plot, name, value) { }
+    static void addToPlot(PlotComposite &plot, String name, bool &value) {
+        new PlotBool(plot, name, value);
+    }
 };
 
+/*
+SerialPlot prints the shown channels as name:value lines for the Arduino serial
+plotter.  Sending it BINARY over the serial line switches to PlotFrame records
+instead, which are several times smaller and take no number formatting; TEXT
+switches back.  The channel table goes out first and again whenever +name, -name,
+ALL or NONE changes what's shown, so a host that has lost track can send BINARY to
+get it again.
+
+Example:
+MainSchedule schedule;
+SerialPlot plot(schedule);
+EncoderWheel wheel(schedule, 2, 3, value);
+void setup() { Serial.begin(115200); wheel.plot(plot, "wheel"); plot.binary(true); schedule.begin(); }
+*/
 class SerialPlot : public Clock, private EdgeDetectorBase, public PlotComposite {
     Channels _channels;
     long _time;
     bool _clock;
+    bool _binary;
+    bool _describe;
+    uint8_t _sequence;
+    PlotFrame _frame;
     static const long DefaultTime = 200;
 public:
     SerialPlot(Schedule &schedule) :
         Clock(schedule, _time, _time, _clock),
         EdgeDetectorBase(schedule, _clock),
-        _time(DefaultTime >> 1) { enable(false); enable(true); }
-    void show(String channels) { _channels.add(channels); }
+        _time(DefaultTime >> 1), _binary(false), _describe(false), _sequence(0) { enable(false); enable(true); }
+    void show(String channels) { _channels.add(channels); _describe = true; }
+    void binary(bool value) {
+        _binary = value;
+        _describe = value;
+    }
+    bool binary() const { return _binary; }
+    // Binary records too big to send; see PlotFrame.
+    unsigned long oversize() const { return _frame.oversize(); }
     void onRisingEdge() {
-        if (plot(_channels)) {
+        if (_binary) {
+            if (_describe) {
+                sendTable();
+            }
+            _frame.beginSample(_sequence++);
+            sample(_channels, _frame);
+            _frame.end();
+        } else if (plot(_channels)) {
             Serial.println();
         }
         //_channels.println();
@@ -112,12 +406,23 @@ public:
         if (Serial.available()) {
             String s = Serial.readString();
             s.trim();
-            if (s == "ALL") { _channels.showAll(); }
-            if (s == "NONE") { _channels.showNone(); }
-            if (s[0] == '-') { _channels.remove(s.substring(1)); }
-            if (s[0] == '+') { _channels.add(s.substring(1)); }
+            if (s == "ALL") { _channels.showAll(); _describe = true; }
+            if (s == "NONE") { _channels.showNone(); _describe = true; }
+            if (s == "BINARY") { binary(true); }
+            if (s == "TEXT") { binary(false); }
+            if (s[0] == '-') { _channels.remove(s.substring(1)); _describe = true; }
+            if (s[0] == '+') { _channels.add(s.substring(1)); _describe = true; }
         }
     }
+private:
+    void sendTable() {
+        uint8_t count = 0;
+        describe(_channels, _frame, count);
+        _frame.begin('E');
+        _frame.putByte(count);
+        _frame.end();
+        _describe = false;
+    }
 };
 
 #endif
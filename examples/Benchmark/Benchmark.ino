@@ -0,0 +1,457 @@
+/*
+ * Microbenchmarks for the scheduler and component library.
+ *
+ * Meant to be run on Linux against the host simulation in Arduino.hpp:
+ *   g++ -std=gnu++17 -O2 -DHOST_MAIN -I. -Ihost -x c++ examples/Benchmark/Benchmark.ino -o benchmark
+ *   ./benchmark 0 > bench.csv
+ * It also builds for a board (with much smaller sizes), where it prints over Serial.
+ *
+ * Everything runs in setup() and prints one CSV row per measurement:
+ *   benchmark,param,count,nsPerOp,allocsPerOp
+ * (benchmark, param, count) is a stable key, so runs from two commits can be joined
+ * on it to spot regressions.  allocsPerOp is -1 where allocations can't be counted.
+ */
+
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+
+#include <Scheduler.hpp>
+#include <Clock.hpp>
+#include <EdgeDetector.hpp>
+#include <PinIO.hpp>
+#include <Led.hpp>
+#include <Debouncer.hpp>
+#include <KeyMatrix.hpp>
+#include <EncoderWheel.hpp>
+#include <SerialPlot.hpp>
+#include <Graphics.hpp>
+
+#ifdef ARDUINO_HOST
+uint64_t nanosNow() { return hostNanos(); }
+long allocationsNow() { return hostAllocations; }
+void quiet(bool value) { Serial.echo(!value); Serial.capture(!value); }
+const long MaxCount = 10000;
+const long OpsPerRun = 2000000L;
+#else
+uint64_t nanosNow() { return (uint64_t)micros() * 1000; }
+long allocationsNow() { return -1; }
+void quiet(bool value) { }
+const long MaxCount = 30;
+const long OpsPerRun = 20000L;
+#endif
+
+const long counts[] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+const int numCounts = sizeof(counts) / sizeof(counts[0]);
+const int depths[] = { 1, 2, 4, 8, 16 };
+const int numDepths = sizeof(depths) / sizeof(depths[0]);
+const int clkPin = 2;
+const int dtPin = 3;
+
+// Times whatever runs between construction and stop(ops), and prints the row.
+class Measurement {
+  const char *_name;
+  const char *_param;
+  long _count;
+  long _allocations;
+  uint64_t _start;
+public:
+  Measurement(const char *name, const char *param, long count) :
+    _name(name), _param(param), _count(count) {
+    _allocations = allocationsNow();
+    _start = nanosNow();
+  }
+  void stop(long ops) {
+    uint64_t elapsed = nanosNow() - _start;
+    long allocations = allocationsNow() - _allocations;
+    quiet(false);
+    Serial.print(_name);
+    Serial.print(",");
+    Serial.print(_param);
+    Serial.print(",");
+    Serial.print(_count);
+    Serial.print(",");
+    Serial.print((double)elapsed / ops, 2);
+    Serial.print(",");
+    if (_allocations < 0) {
+      Serial.println(-1L);
+    } else {
+      Serial.println((double)allocations / ops, 3);
+    }
+  }
+};
+
+long repeats(long opsPerRepeat) {
+  return max(1L, OpsPerRun / max(1L, opsPerRepeat));
+}
+
+class NopPoller : public Scheduled {
+public:
+  long count;
+  NopPoller(Schedule &schedule) : Scheduled(schedule), count(0) { }
+  void poll() { count++; }
+};
+
+class Nothing : public ScheduledTimer {
+public:
+  Nothing(Schedule &schedule, long time) : ScheduledTimer(schedule, time) { }
+  void onExpired() { }
+};
+
+class EdgeCount : private EdgeDetectorBase {
+public:
+  long edges;
+  EdgeCount(Schedule &schedule, bool &value) : EdgeDetectorBase(schedule, value), edges(0) { }
+  void onRisingEdge() { edges++; }
+  void onFallingEdge() { }
+};
+
+void benchmarkList() {
+  for (int c = 0; c < numCounts && counts[c] <= MaxCount; c++) {
+    long count = counts[c];
+    long reps = repeats(count);
+    List<long> list;
+    Measurement add("list_add", "", count);
+    for (long r = 0; r < reps; r++) {
+      list.clear();
+      for (long i = 0; i < count; i++) list.add(i);
+    }
+    add.stop(reps * count);
+
+    // item(i) walks from the head, so keep the total work bounded.
+    long lookups = repeats(count);
+    volatile long sink = 0;
+    Measurement item("list_item", "", count);
+    for (long i = 0; i < lookups; i++) sink += list.item((i * 7919) % count);
+    item.stop(lookups);
+
+    Measurement iterate("list_iterate", "", count);
+    for (long r = 0; r < reps; r++) {
+      for (List<long>::Iterator i = list.items(); !i.done(); i.next()) sink += i.current();
+    }
+    iterate.stop(reps * count);
+  }
+}
+
+PollerComposite dynamicPollers;
+StaticMainSchedule<MaxCount> staticPollers;
+
+// StaticSchedule takes its types at compile time, so its rows are built out of tens.
+ManualSchedule manual;
+class NopTen {
+  NopPoller _0, _1, _2, _3, _4, _5, _6, _7, _8, _9;
+  StaticSchedule<NopPoller, NopPoller, NopPoller, NopPoller, NopPoller,
+    NopPoller, NopPoller, NopPoller, NopPoller, NopPoller> _fixed;
+public:
+  NopTen() : _0(manual), _1(manual), _2(manual), _3(manual), _4(manual),
+    _5(manual), _6(manual), _7(manual), _8(manual), _9(manual),
+    _fixed(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9) { }
+  void poll() { _fixed.poll(); }
+};
+NopTen tens[MaxCount >= 100 ? 10 : 3];
+StaticSchedule<NopTen> static10(tens[0]);
+StaticSchedule<NopTen, NopTen, NopTen> static30(tens[0], tens[1], tens[2]);
+#if defined(ARDUINO_HOST)
+StaticSchedule<NopTen, NopTen, NopTen, NopTen, NopTen, NopTen, NopTen, NopTen, NopTen, NopTen> static100(
+  tens[0], tens[1], tens[2], tens[3], tens[4], tens[5], tens[6], tens[7], tens[8], tens[9]);
+#endif
+
+template <class S>
+void benchmarkStaticSchedule(S &fixed, long count) {
+  long passes = repeats(count);
+  Measurement m("schedule_poll", "StaticSchedule", count);
+  for (long p = 0; p < passes; p++) fixed.poll();
+  m.stop(passes * count);
+}
+
+void benchmarkSchedules() {
+  long added = 0;
+  for (int c = 0; c < numCounts && counts[c] <= MaxCount; c++) {
+    long count = counts[c];
+    for (; added < count; added++) {
+      new NopPoller(dynamicPollers);
+      new NopPoller(staticPollers);
+    }
+    long passes = repeats(count);
+    Measurement dynamic("schedule_poll", "List", count);
+    for (long p = 0; p < passes; p++) dynamicPollers.poll();
+    dynamic.stop(passes * count);
+    Measurement fixed("schedule_poll", "StaticList", count);
+    for (long p = 0; p < passes; p++) staticPollers.poll();
+    fixed.stop(passes * count);
+    if (count == 10) benchmarkStaticSchedule(static10, count);
+    if (count == 30) benchmarkStaticSchedule(static30, count);
+#if defined(ARDUINO_HOST)
+    if (count == 100) benchmarkStaticSchedule(static100, count);
+#endif
+  }
+}
+
+void benchmarkDepth() {
+  const int perGroup = 10;
+  for (int d = 0; d < numDepths; d++) {
+    int depth = depths[d];
+    PollerComposite *root = new PollerComposite();
+    Schedule *parent = root;
+    for (int level = 0; level < depth; level++) {
+      PollGroup *group = new PollGroup(*parent);
+      for (int i = 0; i < perGroup; i++) new NopPoller(*group);
+      parent = group;
+    }
+    long leaves = (long)depth * perGroup;
+    long passes = repeats(leaves);
+    Measurement m("composite_depth", "", depth);
+    for (long p = 0; p < passes; p++) root->poll();
+    m.stop(passes * leaves);
+  }
+}
+
+void benchmarkTimers() {
+  Timer timer(1000);
+  volatile bool sink = false;
+  Measurement expired("timer_expired", "", 1);
+  for (long i = 0; i < OpsPerRun; i++) sink = timer.expired();
+  expired.stop(OpsPerRun);
+  (void)sink;
+
+  for (int c = 0; c < numCounts && counts[c] <= MaxCount; c++) {
+    long count = counts[c];
+    PollerComposite *schedule = new PollerComposite();
+    Nothing *last = NULL;
+    for (long i = 0; i < count; i++) last = new Nothing(*schedule, 3600000L);
+    Measurement idle("deadline_idle_pass", "", count);
+    for (long p = 0; p < OpsPerRun; p++) schedule->poll();
+    idle.stop(OpsPerRun);
+    long resets = repeats(count);
+    Measurement reset("deadline_reset", "", count);
+    for (long r = 0; r < resets; r++) last->reset(3600000L + (r & 1));
+    reset.stop(resets);
+  }
+}
+
+void benchmarkEdges() {
+  for (int c = 0; c < numCounts && counts[c] <= MaxCount; c++) {
+    long count = counts[c];
+    PollerComposite *schedule = new PollerComposite();
+    bool *value = new bool(false);
+    for (long i = 0; i < count; i++) new EdgeCount(*schedule, *value);
+    long passes = repeats(count);
+    Measurement m("edge_detector", "", count);
+    for (long p = 0; p < passes; p++) {
+      *value = !*value;
+      schedule->poll();
+    }
+    m.stop(passes * count);
+  }
+}
+
+// Reads through the schedule's PortSnapshot, vs. a digitalRead() each.  The direct
+// ones are made on a ManualSchedule (which has no snapshot) and then added to a plain
+// list, so both go through the same loop.
+void benchmarkDigitalRead() {
+  for (int c = 0; c < numCounts && counts[c] <= min(MaxCount, 1000L); c++) {
+    long count = counts[c];
+    PollerComposite *snapshot = new PollerComposite();
+    PollerComposite *direct = new PollerComposite();
+    ManualSchedule manual;
+    bool *values = new bool[count];
+    for (long i = 0; i < count; i++) {
+      new DigitalRead(*snapshot, 2 + i % 12, values[i]);
+      direct->add(new DigitalRead(manual, 2 + i % 12, values[i]));
+    }
+    long passes = repeats(count);
+    Measurement shared("digital_read", "snapshot", count);
+    for (long p = 0; p < passes; p++) snapshot->poll();
+    shared.stop(passes * count);
+    Measurement each("digital_read", "digitalRead", count);
+    for (long p = 0; p < passes; p++) direct->poll();
+    each.stop(passes * count);
+  }
+}
+
+// SevenSegLEDs writing through the schedule's PortLatch, vs. a digitalWrite() per
+// segment, set up the same way as benchmarkDigitalRead().  ns per display.
+void benchmarkSevenSeg() {
+  static int segments[7] = { 2, 3, 4, 5, 6, 7, 8 };
+  for (int c = 0; c < numCounts && counts[c] <= min(MaxCount, 1000L); c++) {
+    long count = counts[c];
+    PollerComposite *latched = new PollerComposite();
+    PollerComposite *direct = new PollerComposite();
+    ManualSchedule manual;
+    short *digits = new short[count];
+    for (long i = 0; i < count; i++) {
+      digits[i] = i % 10;
+      new SevenSegLED(*latched, segments, digits[i]);
+      direct->add(new SevenSegLED(manual, segments, digits[i]));
+    }
+    long passes = repeats(count * 7);
+    Measurement latch("seven_seg", "latch", count);
+    for (long p = 0; p < passes; p++) latched->poll();
+    latch.stop(passes * count);
+    Measurement each("seven_seg", "digitalWrite", count);
+    for (long p = 0; p < passes; p++) direct->poll();
+    each.stop(passes * count);
+  }
+}
+
+// One update() of a vertical counter debouncer, for each word size.  ns per update,
+// which shouldn't depend on how many of the bits are buttons.
+template <class T>
+void benchmarkDebouncer(long bits) {
+  Debouncer<T> debouncer;
+  for (int i = 0; i < bits; i++) debouncer.setTicks(i, 1 + i % 16);
+  volatile T sink = 0;
+  Measurement m("debouncer_update", "", bits);
+  for (long i = 0; i < OpsPerRun; i++) sink = debouncer.update((T)(i * 2654435761UL));
+  m.stop(OpsPerRun);
+  (void)sink;
+}
+
+// An 8x8 KeyMatrix with one key held; ns per pass (one row each).  An 8x8 pad needs
+// 8000 passes a second to scan at 1kHz.
+void benchmarkKeyMatrix() {
+  static const uint8_t rows[8] = { 2, 3, 4, 5, 6, 7, 8, 9 };
+  static const uint8_t cols[8] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+  PollerComposite *schedule = new PollerComposite();
+  new KeyMatrix<8, 8>(*schedule, rows, cols);
+#ifdef ARDUINO_HOST
+  Sim.link(rows[3], cols[4]);
+#endif
+  Measurement m("key_matrix_pass", "8x8", 64);
+  for (long p = 0; p < OpsPerRun; p++) schedule->poll();
+  m.stop(OpsPerRun);
+#ifdef ARDUINO_HOST
+  Sim.link(rows[3], cols[4], false);
+#endif
+}
+
+void benchmarkEncoders() {
+  // Quadrature sequence for (clk, dt), one step per pass.
+  static const bool clk[4] = { LOW, HIGH, HIGH, LOW };
+  static const bool dt[4] = { LOW, LOW, HIGH, HIGH };
+  for (int c = 0; c < numCounts && counts[c] <= min(MaxCount, 1000L); c++) {
+    long count = counts[c];
+    PollerComposite *schedule = new PollerComposite();
+    int *values = new int[count];
+    for (long i = 0; i < count; i++) new EncoderWheel(*schedule, clkPin, dtPin, values[i]);
+    long passes = repeats(count);
+    Measurement m("encoder_wheel", "", count);
+    for (long p = 0; p < passes; p++) {
+#ifdef ARDUINO_HOST
+      Sim.set(clkPin, clk[p & 3]);
+      Sim.set(dtPin, dt[p & 3]);
+#endif
+      schedule->poll();
+    }
+    m.stop(passes * count);
+  }
+}
+
+void benchmarkPlot() {
+  for (int c = 0; c < numCounts && counts[c] <= min(MaxCount, 100L); c++) {
+    long count = counts[c];
+    PlotComposite *plot = new PlotComposite();
+    long *values = new long[count];
+    for (long i = 0; i < count; i++) {
+      values[i] = i;
+      new PlotNum<long>(*plot, String("c") + String(i), values[i]);
+    }
+    Channels shown;
+    Channels hidden;
+    hidden.showNone();
+    hidden.add("c0");
+    long ticks = repeats(count * 10);
+    quiet(true);
+    Measurement all("serialplot_plot", "shown", count);
+    for (long t = 0; t < ticks; t++) plot->plot(shown);
+    all.stop(ticks * count);
+    quiet(true);
+    Measurement one("serialplot_plot", "hidden", count);
+    for (long t = 0; t < ticks; t++) plot->plot(hidden);
+    one.stop(ticks * count);
+    PlotFrame frame;
+    quiet(true);
+    Measurement binary("serialplot_plot", "binary", count);
+    for (long t = 0; t < ticks; t++) {
+      frame.beginSample((uint8_t)t);
+      plot->sample(shown, frame);
+      frame.end();
+    }
+    binary.stop(ticks * count);
+  }
+}
+
+// The same shape drawn through the SSD1306 driver (a drawPixel() call per pixel) and
+// a FrameBuffer (spans a byte at a time).  ns per shape.
+void drawShape(Adafruit_GFX &gfx, int shape, long i) {
+  int16_t x = i & 63;
+  switch (shape) {
+  case 0: gfx.fillCircle(x + 32, 16, 12, SSD1306_WHITE); break;
+  case 1: gfx.fillRect(x, 4, 48, 24, SSD1306_INVERSE); break;
+  case 2: gfx.drawLine(x, 0, x + 60, 31, SSD1306_WHITE); break;
+  case 3: gfx.setCursor(x, 12); gfx.print("12:34"); break;
+  }
+}
+
+void benchmarkRaster() {
+  static const char *shapes[] = { "raster_fill_circle", "raster_fill_rect", "raster_line", "raster_text" };
+  Adafruit_SSD1306 *display = new Adafruit_SSD1306(128, 32, &Wire, -1);
+  display->begin(SSD1306_SWITCHCAPVCC, 0x3C);
+  FrameBuffer *frame = new FrameBuffer(128, 32);
+  long draws = repeats(1000);
+  for (int shape = 0; shape < 4; shape++) {
+    Measurement driver(shapes[shape], "driver", 1);
+    for (long i = 0; i < draws; i++) drawShape(*display, shape, i);
+    driver.stop(draws);
+    Measurement buffer(shapes[shape], "framebuffer", 1);
+    for (long i = 0; i < draws; i++) drawShape(*frame, shape, i);
+    buffer.stop(draws);
+  }
+}
+
+// An 8x8 sprite at a position that moves across pages: Adafruit_GFX::drawBitmap()
+// (row-major, a pixel at a time) against FrameBuffer::blit() shifting on the fly and
+// from pre-shifted copies.  ns per sprite.
+// The ball is symmetric, so its bytes are the same in either layout.
+const uint8_t ballBitmap[] PROGMEM = { 0x3C, 0x7E, 0xFF, 0xFF, 0xFF, 0xFF, 0x7E, 0x3C };
+
+void benchmarkSprites() {
+  FrameBuffer *frame = new FrameBuffer(128, 64);
+  const SpriteImage ball = { 8, 8, ballBitmap, ballBitmap, 1, false };
+  uint8_t *image = new uint8_t[ball.preshiftedSize()];
+  uint8_t *mask = new uint8_t[ball.preshiftedSize()];
+  const SpriteImage shifted = ball.preshift(image, mask);
+  long draws = repeats(100);
+  Measurement bitmap("sprite_8x8", "drawBitmap", 1);
+  for (long i = 0; i < draws; i++) frame->drawBitmap(i & 127, (i >> 3) & 63, ballBitmap, 8, 8, SSD1306_WHITE);
+  bitmap.stop(draws);
+  Measurement plain("sprite_8x8", "blit", 1);
+  for (long i = 0; i < draws; i++) frame->blit(i & 127, (i >> 3) & 63, ball);
+  plain.stop(draws);
+  Measurement preshifted("sprite_8x8", "blit_preshifted", 1);
+  for (long i = 0; i < draws; i++) frame->blit(i & 127, (i >> 3) & 63, shifted);
+  preshifted.stop(draws);
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) { }
+  Serial.println("benchmark,param,count,nsPerOp,allocsPerOp");
+  benchmarkList();
+  benchmarkSchedules();
+  benchmarkDepth();
+  benchmarkTimers();
+  benchmarkEdges();
+  benchmarkDigitalRead();
+  benchmarkSevenSeg();
+  benchmarkDebouncer<uint8_t>(8);
+  benchmarkDebouncer<uint16_t>(16);
+  benchmarkDebouncer<uint32_t>(32);
+  benchmarkKeyMatrix();
+  benchmarkEncoders();
+  benchmarkPlot();
+  benchmarkRaster();
+  benchmarkSprites();
+}
+
+void loop() { }
@@ -5,7 +5,7 @@ bool ledState = LOW;
 long ledDelay = 200;
 
 MainSchedule schedule;
-Clock clock(schedule, ledDelay, ledDelay, ledState);
+Clock ledClock(schedule, ledDelay, ledDelay, ledState);
 DigitalLED led(schedule, ledState, LED_BUILTIN);
 
 void setup() {
@@ -6,7 +6,7 @@
 #include <Graphics.hpp>
 #include "Paddle.hpp"
 
-class Ball : public Drawable, private Scheduled {
+class Ball : public Drawable, private ScheduledTimer {
   int16_t _x;
   int16_t _y;
   int16_t _radius;
@@ -15,21 +15,25 @@ class Ball : public Drawable, private Scheduled {
   int16_t _dt;
   int16_t _width;
   int16_t _height;
-  Timer _timer;
   int16_t _score1;
   int16_t _score2;
   Paddle &_player1;
   Paddle &_player2;
+  Label _scoreboard1;
+  Label _scoreboard2;
 public:
   Ball(Schedule &schedule, MainWindow &window, Paddle &player1, Paddle &player2, int16_t width, int16_t height) :
-    Scheduled(schedule), _x(width >> 1), _y(height >> 1), _width(width), _height(height),
-    _player1(player1), _player2(player2), _radius(2), _dx(3), _dy(2), _dt(100) {
+    ScheduledTimer(schedule, MAX_LONG), _x(width >> 1), _y(height >> 1), _width(width), _height(height),
+    _player1(player1), _player2(player2), _radius(2), _dx(3), _dy(2), _dt(100),
+    _scoreboard1(window, width >> 2, 0), _scoreboard2(window, 3 * (width >> 2), 0) {
       window.add(this);
-      _timer.reset(_dt);
+      reset(_dt);
       newgame();
     }
   void newgame() {
     _score1 = _score2 = 0;
+    _scoreboard1.setNumber(_score1);
+    _scoreboard2.setNumber(_score2);
     newball();
   }
   void newball() {
@@ -43,61 +47,56 @@ public:
     _x = _width >> 1;
     _y = _height >> 1;
   }
+  Rect bounds() const { return Rect::around(_x, _y, _radius); }
   void draw(Adafruit_GFX &display) {
     display.fillCircle(_x, _y, _radius, SSD1306_WHITE);
-    display.setTextSize(1);
-    display.setTextColor(SSD1306_WHITE);
-    int16_t q = _width >> 2;
-    display.setCursor(q, 0);
-    display.print(_score1, DEC);
-    display.setCursor(3*q, 0);
-    display.print(_score2, DEC);
   }
-  void poll() {
-    if (_timer.expired()) {
-      _timer.reset(_dt);
-      _x += _dx;
-      _y += _dy;
+  void onExpired() {
+    reset(_dt);
+    invalidate();
+    _x += _dx;
+    _y += _dy;
 
-      // Wall hit Tests
-      if (hittest(-MAX_INT, _height - _radius, MAX_INT, MAX_INT)) {
-        _dy = -abs(_dy);
-        _dx = randomize(_dx);
-      }
+    // Wall hit Tests
+    if (hittest(-MAX_INT, _height - _radius, MAX_INT, MAX_INT)) {
+      _dy = -abs(_dy);
+      _dx = randomize(_dx);
+    }
 #ifndef DEBUG
-      if (hittest(-MAX_INT, -MAX_INT, MAX_INT, _radius)) {
-        _dy = abs(_dy);
-        _dy = randomize(_dy);
-      }
-      // Paddle hit tests
-      int16_t dp = 2; // paddle's "depth"
-      int16_t px = _player1.x();
-      int16_t y0 = _player1.y0();
-      int16_t y1 = _player1.y1();
-      if (hittest(px - dp, y0, px + dp, y1)) {
-        _dx = abs(_dx);
-        _dy = randomize(_dy);
-      }
-      px = _player2.x();
-      y0 = _player2.y0();
-      y1 = _player2.y1();
-      if (hittest(px - dp, y0, px + dp, y1)) {
-        _dx = -abs(_dx);
-        _dy = randomize(_dy);
-      }
-      // Point end hit tests
-      if (hittest(_width + 5 * _radius, -MAX_INT, MAX_INT, MAX_INT)) {
-        _score1++;
-        if (_score1 >= 10) newgame();
-        else newball();
-      }
-      if (hittest(-MAX_INT, -MAX_INT, -5 * _radius, MAX_INT)) {
-        _score2++;
-        if (_score2 >= 10) newgame();
-        else newball();
-      }
-#endif
+    if (hittest(-MAX_INT, -MAX_INT, MAX_INT, _radius)) {
+      _dy = abs(_dy);
+      _dy = randomize(_dy);
+    }
+    // Paddle hit tests
+    int16_t dp = 2; // paddle's "depth"
+    int16_t px = _player1.x();
+    int16_t y0 = _player1.y0();
+    int16_t y1 = _player1.y1();
+    if (hittest(px - dp, y0, px + dp, y1)) {
+      _dx = abs(_dx);
+      _dy = randomize(_dy);
+    }
+    px = _player2.x();
+    y0 = _player2.y0();
+    y1 = _player2.y1();
+    if (hittest(px - dp, y0, px + dp, y1)) {
+      _dx = -abs(_dx);
+      _dy = randomize(_dy);
     }
+    // Point end hit tests
+    if (hittest(_width + 5 * _radius, -MAX_INT, MAX_INT, MAX_INT)) {
+      _score1++;
+      _scoreboard1.setNumber(_score1);
+      if (_score1 >= 10) newgame();
+      else newball();
+    }
+    if (hittest(-MAX_INT, -MAX_INT, -5 * _radius, MAX_INT)) {
+      _score2++;
+      _scoreboard2.setNumber(_score2);
+      if (_score2 >= 10) newgame();
+      else newball();
+    }
+#endif
   }
 private:
   bool hittest(int16_t x0, int16_t y0, int16_t x1, int16_t y1) const {
@@ -14,6 +14,7 @@ public:
     _x(x), _y(height >> 1), _size(size) {
     window.add(this);
   }
+  Rect bounds() const { return Rect(_x, y0(), 1, y1() - y0() + 1); }
   void draw(Adafruit_GFX &display) {
     display.drawLine(_x, y0(), _x, y1(), SSD1306_WHITE);
   }
@@ -33,6 +33,7 @@ MainWindow window(schedule, display);
 Paddle player1(schedule, window, Config.Left.Encoder, 0, PADDLE_SIZE, SCREEN_HEIGHT);
 Paddle player2(schedule, window, Config.Right.Encoder, SCREEN_WIDTH - 1, PADDLE_SIZE, SCREEN_HEIGHT);
 Ball ball(schedule, window, player1, player2, SCREEN_WIDTH, SCREEN_HEIGHT);
+void onNewGamePressed();
 ButtonHandler newGameButton(schedule, Config.Left.Button, &onNewGamePressed);
 
 void onNewGamePressed() {
@@ -51,8 +51,10 @@ ButtonController saveController(schedule, saveTime, keyPressDelay, saveKey);
 Enabled *controls[] = { &buttonController, &saveController, 0 };
 EnableComposite controller(controls);
 
-EncoderControl castRate(schedule, Config.Left.Encoder, upTime, -20, upTime*2);
-EncoderControl castTime(schedule, Config.Right.Encoder, downTime, -20, downTime*2);
+// Fine control when turned slowly, and across the range in a couple of turns when spun.
+const Acceleration knobAcceleration(5, 40, 6);
+EncoderControl castRate(schedule, Config.Left.Encoder, upTime, -20, upTime*2, knobAcceleration);
+EncoderControl castTime(schedule, Config.Right.Encoder, downTime, -20, downTime*2, knobAcceleration);
 
 ToggleButton leftButton(schedule, Config.Left.Button, controller);
 
@@ -0,0 +1,2 @@
+// Host stand-in for <Adafruit_GFX.h>; see Arduino.hpp.
+#include <Arduino.hpp>
@@ -0,0 +1,2 @@
+// Host stand-in for <Adafruit_SSD1306.h>; see Arduino.hpp.
+#include <Arduino.hpp>
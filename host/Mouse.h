@@ -0,0 +1,2 @@
+// Host stand-in for <Mouse.h>; see Arduino.hpp.
+#include <Arduino.hpp>
@@ -0,0 +1,2 @@
+// Host stand-in for <SPI.h>; see Arduino.hpp.
+#include <Arduino.hpp>
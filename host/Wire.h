@@ -0,0 +1,2 @@
+// Host stand-in for <Wire.h>; see Arduino.hpp.
+#include <Arduino.hpp>
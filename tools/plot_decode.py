@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2022 jffordem
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Turns SerialPlot's binary records (see PlotFrame in SerialPlot.hpp) back into CSV.
+
+Reads a capture file, a serial device or stdin and writes seq,channel,... rows to
+stdout, with a new header whenever the channel table changes.  Reported on stderr:
+gaps in the sequence (dropped), frames that fail their check (bad), and samples or
+tables that arrived with a part missing or didn't match the table (broken).
+
+Example:
+stty -F /dev/ttyACM0 115200 raw -echo
+python3 tools/plot_decode.py /dev/ttyACM0 > plot.csv
+"""
+
+import struct
+import sys
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            raise ValueError("bad block")
+        out += frame[i + 1:i + code]
+        i += code
+        if i < len(frame) and code < 0xFF:
+            out.append(0)
+    return bytes(out)
+
+
+def varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("short varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def read_value(kind, data, pos):
+    if kind == "b":
+        if pos >= len(data):
+            raise ValueError("short bool")
+        return data[pos], pos + 1
+    if kind == "f":
+        if pos + 4 > len(data):
+            raise ValueError("short float")
+        return struct.unpack_from("<f", data, pos)[0], pos + 4
+    value, pos = varint(data, pos)
+    if kind == "i":
+        value = (value >> 1) ^ -(value & 1)
+    return value, pos
+
+
+def format_value(value):
+    return "%.7g" % value if isinstance(value, float) else str(value)
+
+
+class Decoder:
+    def __init__(self, out):
+        self.out = out
+        self.table = []
+        self.pending = []
+        self.header = None
+        self.last = None
+        self.parts = None
+        self.samples = 0
+        self.dropped = 0
+        self.bad = 0
+        self.broken = 0
+
+    def frame(self, raw):
+        try:
+            record = cobs_decode(raw)
+        except ValueError:
+            self.bad += 1
+            return
+        check = 0
+        for byte in record:
+            check ^= byte
+        if len(record) < 2 or check != 0:
+            self.bad += 1
+            return
+        body = record[:-1]
+        try:
+            if body[0] == ord("T"):
+                self.entry(body)
+            elif body[0] == ord("E"):
+                self.end_table(body)
+            elif body[0] == ord("S"):
+                self.part(body)
+            else:
+                self.bad += 1
+        except IndexError:
+            self.bad += 1
+        except ValueError:
+            self.broken += 1
+
+    def entry(self, body):
+        index, kind, name = body[1], chr(body[2]), body[3:].decode("ascii", "replace")
+        if index == 0:
+            self.pending = []
+        if index != len(self.pending):
+            raise ValueError("table out of order")
+        self.pending.append((name, kind))
+
+    def end_table(self, body):
+        if body[1] != len(self.pending):
+            self.pending = []
+            raise ValueError("incomplete table")
+        self.table = self.pending
+        self.pending = []
+
+    def part(self, body):
+        sequence, part, more = body[1], body[2] & 0x7F, body[2] & 0x80
+        if part == 0:
+            if self.parts is not None:
+                self.broken += 1
+            self.parts = (sequence, 0, bytearray())
+        elif self.parts is None or self.parts[0] != sequence or self.parts[1] + 1 != part:
+            self.parts = None
+            raise ValueError("missing part")
+        data = self.parts[2] + body[3:]
+        self.parts = (sequence, part, data)
+        if not more:
+            self.parts = None
+            self.sample(sequence, bytes(data))
+
+    def sample(self, sequence, data):
+        if self.last is not None:
+            self.dropped += (sequence - self.last - 1) & 0xFF
+        self.last = sequence
+        values = []
+        pos = 0
+        for name, kind in self.table:
+            value, pos = read_value(kind, data, pos)
+            values.append(value)
+        if pos != len(data):
+            raise ValueError("record doesn't match the table")
+        names = [name for name, kind in self.table]
+        if names != self.header:
+            self.header = names
+            self.out.write(",".join(["seq"] + names) + "\n")
+        self.out.write(",".join([str(sequence)] + [format_value(v) for v in values]) + "\n")
+        self.samples += 1
+
+
+def main():
+    source = open(sys.argv[1], "rb", buffering=0) if len(sys.argv) > 1 else sys.stdin.buffer
+    decoder = Decoder(sys.stdout)
+    pending = bytearray()
+    try:
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                break
+            pending += chunk
+            while True:
+                end = pending.find(0)
+                if end < 0:
+                    break
+                if end > 0:
+                    decoder.frame(bytes(pending[:end]))
+                del pending[:end + 1]
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("%d samples, %d dropped, %d bad frames, %d broken\n" %
+                     (decoder.samples, decoder.dropped, decoder.bad, decoder.broken))
+
+
+if __name__ == "__main__":
+    main()